@@ -3,23 +3,71 @@
  * Date: 10/15/25
  * ABCU Course planner.
  * CLI Menu for the user to load and parse the data into the data structure.
- * It uses a hash table with chaining and dynamic resize.
+ * It uses a hash table with chaining and dynamic resize, or optionally
+ * a flat open addressing table with control bytes.
  * Offers the option to print all of the data sorted or
  * search for a specific course and its prerequisites.
  ***************************************************************************/
 // C++ headers
 #include <algorithm>
+#include <charconv> // to_chars for the catalog generator
+#include <atomic> // work counter for parallelFor, SpscQueue indexes
+#include <chrono> // steady_clock for timing and the benchmarks
+#include <deque> // stable course storage for the stream loader
 #include <fstream> // ifstream, ofstream, fstream | file input/output
+#include <iomanip> // setw for the statistics table
 #include <iostream> // cin,cout,cerr,clog | input/output from console
 #include <limits>
+#include <queue> // priority_queue for term limited plans
+#include <memory> // unique_ptr for the arena blocks
+#include <mutex> // guards the lazy rebuild of the sorted index
 #include <set> 
 #include <sstream> // for parsing string input
 #include <string> 
+#include <string_view> // non-owning views into the arena and mapped files
+#include <thread> // worker threads for the parallel loader
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 // C headers
 #include <cctype> // char conversion; isdigit, letter, whitespace, etc.
 #include <climits> // UINT_MAX sentinel, can be replaced.
-#include <ctime> // clock
+#include <cmath> // pow for the generator's zipf weights
+#include <cstdint> // fixed width integers for the flat table
+#include <cstdio> // remove for the scratch benchmark catalog
+#include <cstdlib> // strtoul, strtod
+#include <cstring> // memcpy
+// platform headers for memory mapped files
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <xmmintrin.h> // _mm_prefetch
+#include <psapi.h> // GetProcessMemoryInfo for peak RSS
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h> // getrusage for peak RSS
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// SIMD for the CSV scanner, AVX2 is only used after a run time check
+#if defined(__SSE2__) || defined(_M_X64)
+#define CSV_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h> // __cpuid, _xgetbv, _BitScanForward64
+#endif
+#endif
+
+// commit the benchmark results are tagged with, CMakeLists.txt passes it in
+#ifndef BUILD_COMMIT
+#define BUILD_COMMIT "unknown"
+#endif
 
 using namespace std;
 
@@ -29,8 +77,34 @@ using namespace std;
 
 namespace
 {
-    // default table size, prime number.
+    // default table size, prime number. Rounded up to 32 for the power of two bucket counts of HashPolicy::Word.
     constexpr unsigned int DEFAULT_SIZE = 31;
+    // default slot count for the flat table, must be a power of two.
+    constexpr size_t FLAT_DEFAULT_CAPACITY = 32;
+    // default growth thresholds: courses per bucket (chained) and full slots per slot (flat).
+    constexpr double CHAINED_MAX_LOAD = 1.0;
+    constexpr double FLAT_MAX_LOAD = 0.875;
+    // frontier size below which a planning level isn't worth spreading over threads.
+    constexpr size_t PARALLEL_FRONTIER = 4096;
+    // largest transitive closure bitmatrix the prerequisite graph will build, in bytes.
+    constexpr size_t CLOSURE_MAX_BYTES = 64 * 1024 * 1024;
+    // batch mode and printAll write their output buffer once it gets this big.
+    constexpr size_t OUTPUT_FLUSH_BYTES = 1 << 20;
+    // courses per page when listing by prefix in the menu.
+    constexpr size_t LIST_PAGE_SIZE = 20;
+    // ranked matches shown when a search isn't an exact course number.
+    constexpr size_t SEARCH_RESULTS = 10;
+    // keys findMany hashes and prefetches before resolving them.
+    constexpr size_t FIND_BATCH = 16;
+    // old buckets moved to the new array per Insert while an incremental resize is running.
+    constexpr size_t REHASH_STEP = 8;
+    // control byte for an unused flat slot, full slots hold a 7 bit hash tag so the high bit is never set.
+    constexpr uint8_t FLAT_EMPTY = 0x80;
+    // first 8 bytes of a snapshot file, and the layout version after them.
+    constexpr char SNAPSHOT_MAGIC[8] = { 'A', 'B', 'C', 'U', 'S', 'N', 'A', 'P' };
+    constexpr uint32_t SNAPSHOT_VERSION = 3;
+    // a snapshot body is checksummed in blocks of this many bytes, in parallel.
+    constexpr size_t SNAPSHOT_BLOCK = 8 << 20;
 
     // trim whitespace from text
     string trim(const string& text)
@@ -46,7 +120,16 @@ namespace
         return text.substr(first, (last - first + 1));
     }
 
-    // split CSV line into fields
+    // trim whitespace from a view, no copy
+    string_view trimView(string_view text)
+    {
+        size_t first = text.find_first_not_of(" \t\n\r");
+        if (first == string_view::npos) return string_view();
+        size_t last = text.find_last_not_of(" \t\n\r");
+        return text.substr(first, (last - first + 1));
+    }
+
+    // split CSV line into fields, no quoting (the loaders use CsvReader, the benchmarks still time this)
     vector<string> splitCSV(const string& line)
     {
         vector<string> result;
@@ -64,8 +147,33 @@ namespace
         return result;
     }
 
+    /**
+     * splitCSVView
+     *
+     * Same split as splitCSV, but the fields are trimmed views into the line.
+     * getline drops an empty last field ("a,b," gives 2 fields), so this does too.
+     * @param line to split, fields is cleared and filled (reused between lines to avoid allocating).
+     */
+    void splitCSVView(string_view line, vector<string_view>& fields)
+    {
+        fields.clear();
+        size_t start = 0;
+        while (true)
+        {
+            size_t comma = line.find(',', start);
+            if (comma == string_view::npos)
+            {
+                // last field, only kept if there's something in it
+                if (start < line.size()) fields.push_back(trimView(line.substr(start)));
+                return;
+            }
+            fields.push_back(trimView(line.substr(start, comma - start)));
+            start = comma + 1;
+        }
+    }
+
     // check if course string contains digit
-    bool containsDigit(const string& course)
+    bool containsDigit(string_view course)
     {
 	    // for each character in course
 		for (char character : course)
@@ -77,6 +185,12 @@ namespace
         return false;
     }
 
+    // a header's first field is a column name, e.g. "Course Number": starts with a letter, no digits
+    bool isHeaderField(string_view field)
+    {
+        return !field.empty() && isalpha(static_cast<unsigned char>(field[0])) && !containsDigit(field);
+    }
+
 	/**
 	 * isPrime
 	*
@@ -121,477 +235,7779 @@ namespace
         }
         return num; // returns the next prime
     }
-}
 
-/**
-    * Structure for course data
-    */
-struct Course
-{
-    string courseNumber; // unique identifier -- key for hashing
-    string name; // the course title/name
-    vector<string> prerequisites; // list of prerequisite course numbers
+    inline uint64_t rotateLeft(uint64_t x, int bits) { return (x << bits) | (x >> (64 - bits)); }
 
-    // default constructor
-    Course() = default;
-};
+    constexpr uint64_t HASH_K1 = 0x9E3779B97F4A7C15ULL;
+    constexpr uint64_t HASH_K2 = 0xC2B2AE3D27D4EB4FULL;
 
-//============================================================================
-// Hash Table class definition
-//============================================================================
+    // one word step of hashKey64
+    inline uint64_t mixWord(uint64_t h, uint64_t word) { return rotateLeft(h ^ (word * HASH_K1), 31) * HASH_K2; }
 
-/**
- * Hash Table Class
- *
- * Contains the Node structure, initializes the vector containing the buckets.
- * Initializes the table size for the buckets, tracking of the total elements, and max chain length.
- * It has methods for loading the course data, parsing it, storing it in the data structure.
- * Then searching for a specific course, printing all courses, or resizing the table size if the bucket chain
- * becomes too long.
- */
-class CourseHashTable
-{
-private:
-	// Structure for node chaining
-    struct Node
+    // murmur style finalizer of hashKey64
+    inline uint64_t finishHash(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /**
+     * packShortKey
+     *
+     * Loads a key of at most 15 bytes as two little endian words, zero padded, with the length
+     * in the top byte of the second word (the CourseKey inline layout). Only fixed size loads,
+     * the bytes an overlapping load reads twice are shifted out.
+     * @param p, n the key bytes, n < 16.
+     * @param words receives the two words.
+     */
+    inline void packShortKey(const char* p, size_t n, uint64_t words[2])
     {
-        Course course; // local object for loading course data
-        unsigned int key; // hash key value
-        Node* next; // pointer to the next node in the chain
-        // default constructor
-        Node()
+        uint64_t low = 0, high = 0;
+        if (n >= 8)
         {
-            key = UINT_MAX;
-            next = nullptr;
+            memcpy(&low, p, 8);
+            if (n > 8)
+            {
+                memcpy(&high, p + n - 8, 8);
+                high >>= 8 * (16 - n);
+            }
         }
-        // constructor for resizing
-        Node(Course aCourse, unsigned int aKey)
+        else if (n >= 4)
         {
-            course = aCourse;
-            key = aKey;
-            next = nullptr;
+            uint32_t first, last;
+            memcpy(&first, p, 4);
+            memcpy(&last, p + n - 4, 4);
+            low = first | ((static_cast<uint64_t>(last) >> (8 * (8 - n))) << 32);
         }
-    };
-
-    vector<Node> buckets;
-    // these are set in the constructors. 
-    size_t tableSize; // DEFAULT_SIZE is 31 for a small dataset.
-	size_t numElements; // track total elements
-
-    unsigned int maxChainLength = 4; // threshold for resizing
-
-    unsigned int hash(const string& courseNumber) const;
-    void reSize(); // dynamic resizing when chains get too long
-
-public:
-    CourseHashTable(); // default constructor
-    CourseHashTable(unsigned int size); // constructor for resizing
-    ~CourseHashTable(); // destructor
-
-    void Insert(const Course& course);
-    Course searchCourse(const string& courseNumber) const; 
-    void printAll() const;
-    void Clear(); 
-    size_t Size() const { return numElements; }
-};
-
-/**
- * Default constructor
- * Creates a hash table with DEFAULT_SIZE (31) buckets.
- * And sets the numElements for counting.
- */
-CourseHashTable::CourseHashTable() : tableSize(DEFAULT_SIZE), numElements(0)
-{
-    buckets.resize(tableSize);
-}
-
-/**
- * Size constructor
- * For resizing to a new table if too many chained nodes. (max chain length is 4 to cap worst cases)
- */
-CourseHashTable::CourseHashTable(unsigned int size) : tableSize(size), numElements(0)
-{
-    buckets.resize(tableSize);
-}
-
-/**
- * Destructor
- * Frees all dynamically allocated memory in the chains
- */
-CourseHashTable::~CourseHashTable() {
-    for (size_t i = 0; i < tableSize; i++)
-    {
-        // start with the first chained node
-        Node* current = buckets[i].next;
-        // delete all linked nodes in the chain
-        while (current != nullptr) {
-            Node* temp = current;
-            current = current->next;
-            delete temp;
+        else if (n > 0)
+        {
+            low = static_cast<uint8_t>(p[0]) | (static_cast<uint64_t>(static_cast<uint8_t>(p[n / 2])) << (8 * (n / 2)))
+                | (static_cast<uint64_t>(static_cast<uint8_t>(p[n - 1])) << (8 * (n - 1)));
         }
+        words[0] = low;
+        words[1] = high | (static_cast<uint64_t>(n) << 56);
     }
-}
 
-/**
- * Hash function
- * 
- * @param string courseNumber is passed, then it evaluates a new hash value
- * @return the new hash value
- */
-unsigned int CourseHashTable::hash(const string& courseNumber) const
-{
-    // simple polynomial string hash works better to avoid issues like 101 being used for multiple courses
-    unsigned int hashValue = 0;
-    for (char currChar : courseNumber) {
-        hashValue = hashValue * 31 + currChar;
+    // hashKey64 of a key already packed by packShortKey, the length is in the second word
+    inline uint64_t hashShortKey(const uint64_t words[2], uint64_t seed)
+    {
+        return finishHash(mixWord(mixWord(seed ^ HASH_K2, words[0]), words[1]));
     }
-    return hashValue % tableSize;
-}
-
-/**
- * reSize
- * To automatically resize the hash table when chain length is too long.
- */
-
-void CourseHashTable::reSize()
-{
-    cout << "Resizing hash table from " << tableSize << " to ";
-    // decide the new size of the hash table
-    unsigned int newSize = nextPrime(tableSize * 2);
-    cout << newSize << " buckets.\n";
-    // create the new table with new size
-    CourseHashTable* newTable = new CourseHashTable(newSize);
 
-    // rehash all elements
-    for (size_t i = 0; i < tableSize; i++)
+    /**
+     * hashKey64
+     *
+     * Word at a time hash: the key is read 8 bytes per load (the tail with fixed size overlapping
+     * loads, the length goes into the start value), each word costs a multiply and a rotate, and a murmur style
+     * finalizer mixes the result so the low bits (bucket or slot index), the 7 bit tag and the
+     * upper bits all depend on every byte, even for keys like CSCI101/CSCI102. Keys of 32 bytes
+     * or more run four independent lanes so the multiplies overlap (the compiler can vectorize
+     * them). A different seed gives a different, equally mixed function. Keys under 16 bytes,
+     * nearly every course number, are packed into two words first, the same words a CourseKey
+     * holds, so CourseKey::hash gives the same value without touching the bytes again.
+     * @param key is the course number, seed picks the function.
+     * @return the full 64 bit hash.
+     */
+    uint64_t hashKey64(string_view key, uint64_t seed = 0)
     {
-	    if (buckets[i].key != UINT_MAX)
-	    {
-            newTable->Insert(buckets[i].course);
-            Node* current = buckets[i].next;
-            while (current != nullptr)
+        constexpr uint64_t K1 = HASH_K1;
+        constexpr uint64_t K2 = HASH_K2;
+        const char* p = key.data();
+        size_t n = key.size();
+        if (n < 16)
+        {
+            uint64_t words[2];
+            packShortKey(p, n, words);
+            return hashShortKey(words, seed);
+        }
+        uint64_t h = seed ^ (n * K2);
+        if (n >= 32)
+        {
+            uint64_t lanes[4] = { h, h ^ K1, h + K2, h - K1 };
+            for (; n >= 32; p += 32, n -= 32)
             {
-                newTable->Insert(current->course);
-                current = current->next;
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    uint64_t word;
+                    memcpy(&word, p + 8 * lane, 8);
+                    lanes[lane] = rotateLeft(lanes[lane] ^ (word * K1), 31) * K2;
+                }
             }
-	    }
+            h = lanes[0] ^ rotateLeft(lanes[1], 17) ^ rotateLeft(lanes[2], 29) ^ rotateLeft(lanes[3], 43);
+        }
+        for (; n >= 8; p += 8, n -= 8)
+        {
+            uint64_t word;
+            memcpy(&word, p, 8);
+            h = mixWord(h, word);
+        }
+        if (n > 0)
+        {
+            // the key is at least 16 bytes, so one overlapping load covers the tail, the length is already in h
+            uint64_t word;
+            memcpy(&word, p + n - 8, 8);
+            h = mixWord(h, word);
+        }
+        return finishHash(h);
     }
-    // swap the internals
-    swap(buckets, newTable->buckets);
-    swap(tableSize, newTable->tableSize);
-    swap(numElements, newTable->numElements);
-    // clean up old data that's now swapped
-    delete newTable;
-}
-
-
-/**
- * Insert
- *
- * This is for loading data and inserting it into the data structure.
- * It checks the buckets and inserts it, traverses the chain until it finds an empty one.
- * 
- * @param It passes the course to hash the courseNumber and insert it.
- * @return Upon inserting the course, it returns. It increases the chain length and checks for resizing too.
- */
 
-void CourseHashTable::Insert(const Course& course)
-{
-    unsigned int key = hash(course.courseNumber);
-    // retrieve bucket location using hash key
-    Node* node = &buckets.at(key);
-
-    // if the head bucket/node is empty
-    if (node->key == UINT_MAX)
+    /**
+     * workerCount
+     *
+     * @return the number of hardware threads, at least 1.
+     */
+    unsigned int workerCount()
     {
-        // First course in this bucket direct insert 
-        node->key = key;
-        node->course = course; 
-        node->next = nullptr;
-        numElements++;
-        return;
+        unsigned int threads = thread::hardware_concurrency();
+        return threads == 0 ? 1 : threads;
     }
 
-    // update existing course
-    if (node->course.courseNumber == course.courseNumber)
-    {
-        node->course = course;
-        return;
-    }
-    // traverse chain
-    unsigned int chainLength = 1; 
-    while (node->next != nullptr)
+    /**
+     * parallelFor
+     *
+     * Runs fn(i) for every i in [0, count) on up to workerCount() threads. Threads pull the next
+     * index from a shared counter, so uneven items still balance. A single item runs inline.
+     * @param count of items, fn to call for each.
+     */
+    template <typename Fn>
+    void parallelFor(size_t count, Fn fn)
     {
-        chainLength++;
-        node = node->next;
-        if (node->course.courseNumber == course.courseNumber)
+        size_t threads = min<size_t>(workerCount(), count);
+        if (threads <= 1)
         {
-            node->course = course;
+            for (size_t i = 0; i < count; i++) fn(i);
             return;
         }
+        atomic<size_t> next(0);
+        auto worker = [&]()
+            {
+                for (size_t i = next++; i < count; i = next++) fn(i);
+            };
+        vector<thread> pool;
+        pool.reserve(threads - 1);
+        for (size_t t = 1; t < threads; t++) pool.emplace_back(worker);
+        // this thread works too
+        worker();
+        for (thread& t : pool) t.join();
     }
-    // add new node at end
-    node->next = new Node(course, key);
-    numElements++;
-    chainLength++;
 
-    // check if resize is needed
-    if (chainLength > maxChainLength)
+    /**
+     * SpscQueue
+     *
+     * Bounded single producer, single consumer queue: a ring of CAPACITY slots with an atomic index
+     * per side and no locks. push waits while the ring is full, which is the backpressure that keeps
+     * a fast producer from running ahead, and pop waits while it's empty. Waits yield the core and
+     * their time is added to the caller's counter. close() ends the stream after the last push,
+     * cancel() makes both sides give up, e.g. after an error.
+     */
+    template <typename T, size_t CAPACITY>
+    class SpscQueue
     {
-        cout << "Chain length " << chainLength << " exceeds threshold.\n";
-        reSize();
-    }
+        static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "the capacity has to be a power of 2");
 
-}
+    public:
+        // false if the queue was cancelled, the item isn't queued then
+        bool push(const T& item, double& waitedSeconds)
+        {
+            size_t tail = tailIndex.load(memory_order_relaxed);
+            if (tail - headSeen == CAPACITY)
+            {
+                auto start = chrono::steady_clock::now();
+                while (tail - (headSeen = headIndex.load(memory_order_acquire)) == CAPACITY)
+                {
+                    if (cancelled.load(memory_order_relaxed)) return false;
+                    this_thread::yield();
+                }
+                waitedSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }
+            if (cancelled.load(memory_order_relaxed)) return false;
+            slots[tail % CAPACITY] = item;
+            tailIndex.store(tail + 1, memory_order_release);
+            return true;
+        }
 
-/**
- * searchCourse
- *
- * Searches for a specific course, along with the prerequisites.
- * 
- * @param courseNumber to look up.
- * @return if found, the course, otherwise emptyCourse data, not found.
- */
+        // false once the queue is closed and drained, or cancelled
+        bool pop(T& item, double& waitedSeconds)
+        {
+            size_t head = headIndex.load(memory_order_relaxed);
+            if (head == tailSeen)
+            {
+                auto start = chrono::steady_clock::now();
+                while (head == (tailSeen = tailIndex.load(memory_order_acquire)))
+                {
+                    if (cancelled.load(memory_order_relaxed)) return false;
+                    // the pushes before close() are visible once it is, so one more look settles it
+                    if (closed.load(memory_order_acquire))
+                    {
+                        if (head == tailIndex.load(memory_order_acquire)) return false;
+                        continue;
+                    }
+                    this_thread::yield();
+                }
+                waitedSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }
+            if (cancelled.load(memory_order_relaxed)) return false;
+            item = slots[head % CAPACITY];
+            headIndex.store(head + 1, memory_order_release);
+            return true;
+        }
 
-Course CourseHashTable::searchCourse(const string& courseNumber) const
-{
-    Course emptyCourse; // empty course data to return if not found
+        void close() { closed.store(true, memory_order_release); }
+        void cancel() { cancelled.store(true, memory_order_relaxed); }
 
-    unsigned int key = hash(courseNumber);
-    const Node* node = &buckets.at(key);
+    private:
+        T slots[CAPACITY] = {};
+        // each side on its own cache line, with its last look at the other side's index
+        alignas(64) atomic<size_t> headIndex{ 0 };
+        size_t tailSeen = 0; // consumer only
+        alignas(64) atomic<size_t> tailIndex{ 0 };
+        size_t headSeen = 0; // producer only
+        alignas(64) atomic<bool> closed{ false };
+        atomic<bool> cancelled{ false };
+    };
 
-    // check if bucket is empty
-    if (node->key == UINT_MAX)
+    // hint the CPU to start loading the cache line at address
+    inline void prefetch(const void* address)
     {
-        // not found
-        return emptyCourse;
+#if defined(_MSC_VER)
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+        __builtin_prefetch(address);
+#endif
     }
-    // search through chain
-    while (node != nullptr)
+
+    // reverse the byte order, so little endian loaded text compares as a big endian integer
+    inline uint64_t byteSwap(uint64_t x)
     {
-	    if (node->course.courseNumber == courseNumber)
-	    {
-            // found
-            return node->course;
-	    }
-        // go next
-        node = node->next;
+#if defined(_MSC_VER)
+        return _byteswap_uint64(x);
+#else
+        return __builtin_bswap64(x);
+#endif
     }
-    // not found
-    return emptyCourse;
-}
 
-/**
- * printAll
- *
- * Prints all the courses in sorted order.
- *
- * @return
- */
+    /**
+     * Histogram
+     *
+     * HDR style log-linear histogram for latencies in ns (or any counts). Values under 32 get
+     * their own bucket, above that every power of two is split into 16 buckets, so a recorded
+     * value is off by at most ~6% across the full 64 bit range in under 1000 buckets.
+     * Counts are relaxed atomics so any thread can record.
+     */
+    class Histogram
+    {
+    public:
+        static constexpr size_t BUCKETS = 32 + 59 * 16;
 
-void CourseHashTable::printAll() const
-{
-	// print all courses header
-    cout << "\nCourse List:\n";
-    cout << "============\n";
-    // collect all courses
-    vector<Course> allCourses;
+        Histogram() { reset(); }
 
-    // iterate through all buckets
-    for (size_t i = 0; i < tableSize; ++i)
-    {
-        // if the bucket key isn't empty
-	    if (buckets[i].key != UINT_MAX)
-	    {
-            // add main node course
-            allCourses.push_back(buckets[i].course);
+        void record(uint64_t value)
+        {
+            counts[indexOf(value)].fetch_add(1, memory_order_relaxed);
+            total.fetch_add(1, memory_order_relaxed);
+            sum.fetch_add(value, memory_order_relaxed);
+            uint64_t seen = maximum.load(memory_order_relaxed);
+            while (value > seen && !maximum.compare_exchange_weak(seen, value, memory_order_relaxed)) {}
+        }
+
+        uint64_t count() const { return total.load(memory_order_relaxed); }
+        uint64_t max() const { return maximum.load(memory_order_relaxed); }
+        double mean() const
+        {
+            uint64_t n = count();
+            return n == 0 ? 0.0 : static_cast<double>(sum.load(memory_order_relaxed)) / n;
+        }
 
-            // add chained nodes
-            const Node* node = buckets[i].next;
-            while (node != nullptr)
+        // upper edge of the bucket holding the p-th fraction of the values (p in 0..1)
+        uint64_t percentile(double p) const
+        {
+            uint64_t n = count();
+            if (n == 0) return 0;
+            uint64_t rank = static_cast<uint64_t>(p * n);
+            if (rank >= n) rank = n - 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; i++)
             {
-                allCourses.push_back(node->course);
-                node = node->next;
+                seen += counts[i].load(memory_order_relaxed);
+                if (seen > rank) return min(upperEdge(i), max());
             }
+            return max();
+        }
 
-	    }
-    }
-    // sort courses by courseNumber, using std::sort with begin() and end()
-    // then the predicate as the third argument to define the bool comparison
-    sort(allCourses.begin(), allCourses.end(), [](const Course& a, const Course& b)
+        void reset()
         {
-            return a.courseNumber < b.courseNumber;
-        });
-    // print sorted courses
-    // for each course in allCourses
-	for (const Course& course: allCourses)
-	{
-        cout << course.courseNumber << ", " << course.name << endl;
-	}
-    cout << "\nTotal courses: " << allCourses.size() << endl;
-}
+            for (atomic<uint64_t>& bucket : counts) bucket.store(0, memory_order_relaxed);
+            total.store(0, memory_order_relaxed);
+            sum.store(0, memory_order_relaxed);
+            maximum.store(0, memory_order_relaxed);
+        }
 
-/**
- * Clear
- *
- * Used to clear all data.
- */
+    private:
+        atomic<uint64_t> counts[BUCKETS];
+        atomic<uint64_t> total;
+        atomic<uint64_t> sum;
+        atomic<uint64_t> maximum;
 
-void CourseHashTable::Clear()
-{
-	for (size_t i = 0; i < tableSize; ++i)
-	{
-        Node* current = buckets[i].next;
-        while (current != nullptr)
+        // index of the highest set bit, value has to be non-zero
+        static unsigned int highestBit(uint64_t value)
         {
-            Node* temp = current;
-            current = current->next;
-            delete temp;
+            unsigned int bit = 0;
+            for (unsigned int step = 32; step > 0; step /= 2)
+            {
+                if (value >> step)
+                {
+                    value >>= step;
+                    bit += step;
+                }
+            }
+            return bit;
         }
-        buckets[i].key = UINT_MAX;
-        buckets[i].course = Course();
-        buckets[i].next = nullptr;
-	}
-    numElements = 0;
-}
-
 
-//============================================================================
-// unnamed namespace continued for loadCourses and displayInformation
-// Could be moved up top but requires forward declarations. I prefer this. 
-//============================================================================
+        static size_t indexOf(uint64_t value)
+        {
+            if (value < 32) return static_cast<size_t>(value);
+            unsigned int msb = highestBit(value);
+            // the 4 bits under the top bit pick one of 16 buckets in this power of two
+            return 32 + (msb - 5) * 16 + static_cast<size_t>((value >> (msb - 4)) & 15);
+        }
 
-namespace 
-{
-	/**
-	 * Load a CSV file containing course information into a container
-	 *
-	 * @param filePath the path to the CSV file to load, ht is a pointer to the hash table class.
-	 * @return a container holding all the courses
-	 */
+        static uint64_t upperEdge(size_t index)
+        {
+            if (index < 32) return index;
+            unsigned int msb = static_cast<unsigned int>((index - 32) / 16 + 5);
+            uint64_t sub = (index - 32) % 16;
+            return ((16 + sub + 1) << (msb - 4)) - 1;
+        }
+    };
 
-    bool loadCourses(const string& filePath, CourseHashTable* ht)
+    // operations with a latency histogram
+    enum class Op
     {
-        set<string> courseNumbers; // track valid courses
-        vector<Course> courses; // vector to track what's inserted for validation
-        int lineNumber = 0; // track line numbers
+        Insert,
+        Search,
+        Find,
+        FindMany,
+        ReSize,
+        PrintAll,
+        Clear,
+        LoadParse,
+        LoadValidate,
+        LoadInsert,
+        LoadRead,
+        SnapshotSave,
+        SnapshotLoad,
+        Remove,
+        Count // number of operations, not an operation
+    };
+
+    const char* const OP_NAMES[] = { "Insert", "searchCourse", "findCourse", "findMany", "reSize", "printAll",
+        "Clear", "loadCourses parse", "loadCourses validate", "loadCourses insert",
+        "loadCourses read", "saveSnapshot", "loadSnapshot", "Remove" };
+
+    /**
+     * Metrics
+     *
+     * Process wide instrumentation: a latency histogram per Op, probes per lookup, and counters.
+     * Recording can be switched off with enabled, e.g. while benchmarking.
+     */
+    struct Metrics
+    {
+        atomic<bool> enabled{ true };
+        Histogram latency[static_cast<size_t>(Op::Count)];
+        Histogram probes; // buckets nodes or flat slots looked at per lookup
+        atomic<uint64_t> resizes{ 0 };
+        atomic<uint64_t> rehashedBytes{ 0 }; // entries (nodes or flat slots) moved by resizes
+        atomic<uint64_t> bytesAllocated{ 0 }; // nodes, bucket/slot arrays and arena blocks
+
+        bool on() const { return enabled.load(memory_order_relaxed); }
+        Histogram& of(Op op) { return latency[static_cast<size_t>(op)]; }
+        void addBytes(size_t bytes)
+        {
+            if (on()) bytesAllocated.fetch_add(bytes, memory_order_relaxed);
+        }
+        void reset()
+        {
+            for (Histogram& histogram : latency) histogram.reset();
+            probes.reset();
+            resizes.store(0);
+            rehashedBytes.store(0);
+            bytesAllocated.store(0);
+        }
+    };
+
+    Metrics& metrics()
+    {
+        static Metrics instance;
+        return instance;
+    }
+
+    /**
+     * ScopedTimer
+     *
+     * Records the wall time of a scope (or up to stop()) into the Op's histogram, if metrics are enabled.
+     */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Op timed) : op(timed), active(metrics().on())
+        {
+            if (active) start = chrono::steady_clock::now();
+        }
+        ~ScopedTimer() { stop(); }
+
+        // records now instead of at the end of the scope, for phases that end mid function
+        void stop()
+        {
+            if (!active) return;
+            active = false;
+            auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start);
+            metrics().of(op).record(static_cast<uint64_t>(elapsed.count()));
+        }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Op op;
+        bool active;
+        chrono::steady_clock::time_point start;
+    };
+
+    /**
+     * StringArena
+     *
+     * Monotonic block allocator for course strings. Everything stored in it lives until
+     * Reset(), which keeps the blocks for the next load instead of freeing string by string.
+     */
+    class StringArena
+    {
+    public:
+        // raw storage, used for the prerequisite arrays
+        void* allocate(size_t bytes, size_t alignment)
+        {
+            while (true)
+            {
+                if (current < blocks.size())
+                {
+                    size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+                    if (aligned + bytes <= blockSizes[current])
+                    {
+                        offset = aligned + bytes;
+                        used += bytes;
+                        return blocks[current].get() + aligned;
+                    }
+                    // doesn't fit, move on to the next block
+                    current++;
+                    offset = 0;
+                    continue;
+                }
+                // out of blocks, add one big enough for this request
+                size_t size = max(BLOCK_SIZE, bytes + alignment);
+                blocks.emplace_back(new char[size]);
+                metrics().addBytes(size);
+                blockSizes.push_back(size);
+            }
+        }
+
+        // copy text into the arena and return a view of the stored copy
+        string_view store(string_view text)
+        {
+            if (text.empty()) return string_view();
+            char* copy = static_cast<char*>(allocate(text.size(), 1));
+            memcpy(copy, text.data(), text.size());
+            return string_view(copy, text.size());
+        }
+
+        // forget everything stored, the blocks are kept for reuse
+        void Reset()
+        {
+            current = 0;
+            offset = 0;
+            used = 0;
+        }
+
+        size_t bytesUsed() const { return used; }
+        // bytes held in blocks, used or not
+        size_t bytesReserved() const
+        {
+            size_t total = 0;
+            for (size_t size : blockSizes) total += size;
+            return total;
+        }
+
+    private:
+        static constexpr size_t BLOCK_SIZE = 64 * 1024;
+        vector<unique_ptr<char[]>> blocks;
+        vector<size_t> blockSizes;
+        size_t current = 0; // block currently being filled
+        size_t offset = 0; // bytes used in the current block
+        size_t used = 0; // total bytes handed out
+    };
+
+    // bit n set when byte n of a 64 byte block is a comma, a double quote or a newline
+    using CsvMaskFn = uint64_t (*)(const char* block);
+
+    uint64_t csvMaskScalar(const char* block)
+    {
+        uint64_t mask = 0;
+        for (int i = 0; i < 64; i++)
+        {
+            char c = block[i];
+            mask |= static_cast<uint64_t>(c == ',' || c == '"' || c == '\n') << i;
+        }
+        return mask;
+    }
+
+#ifdef CSV_SIMD_X86
+    // four 16 byte compares
+    uint64_t csvMaskSse2(const char* block)
+    {
+        const __m128i comma = _mm_set1_epi8(','), quote = _mm_set1_epi8('"'), newline = _mm_set1_epi8('\n');
+        uint64_t mask = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, comma), _mm_cmpeq_epi8(bytes, quote)), _mm_cmpeq_epi8(bytes, newline));
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hits))) << (16 * i);
+        }
+        return mask;
+    }
+
+    // two 32 byte compares, only called when cpuHasAvx2()
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((target("avx2")))
+#endif
+    uint64_t csvMaskAvx2(const char* block)
+    {
+        const __m256i comma = _mm256_set1_epi8(','), quote = _mm256_set1_epi8('"'), newline = _mm256_set1_epi8('\n');
+        uint64_t mask = 0;
+        for (int i = 0; i < 2; i++)
+        {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+            __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, comma), _mm256_cmpeq_epi8(bytes, quote)),
+                _mm256_cmpeq_epi8(bytes, newline));
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hits))) << (32 * i);
+        }
+        return mask;
+    }
+
+    bool cpuHasAvx2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        // the OS has to save the YMM registers too
+        bool osSaves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSaves && (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    /**
+     * csvKernels
+     *
+     * The mask kernels this CPU can run, widest last: scalar, then SSE2 and AVX2 on x86.
+     */
+    vector<pair<const char*, CsvMaskFn>> csvKernels()
+    {
+        vector<pair<const char*, CsvMaskFn>> kernels = { { "scalar", csvMaskScalar } };
+#ifdef CSV_SIMD_X86
+        kernels.push_back({ "sse2", csvMaskSse2 });
+        if (cpuHasAvx2()) kernels.push_back({ "avx2", csvMaskAvx2 });
+#endif
+        return kernels;
+    }
+
+    // the widest kernel, picked once
+    CsvMaskFn csvMaskKernel()
+    {
+        static const CsvMaskFn kernel = csvKernels().back().second;
+        return kernel;
+    }
+
+    inline size_t countTrailingZeros(uint64_t x)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, x);
+        return index;
+#else
+        return static_cast<size_t>(__builtin_ctzll(x));
+#endif
+    }
+
+    /**
+     * CsvReader
+     *
+     * RFC 4180 reader over a whole buffer, e.g. a mapped file. Fields are separated by commas and
+     * records end at LF or CRLF. A field in double quotes may hold commas, newlines and "" for a
+     * quote. Unquoted fields are trimmed like splitCSV did, blanks around a quoted field are dropped
+     * and its text is kept as is. Blank lines are skipped, and with detectHeader a first record
+     * whose first field is a column name (isHeaderField) is taken as a header row and skipped, course
+     * numbers all have a digit.
+     * A quote inside an unquoted field, text after a closing quote and a quote that's never closed
+     * are errors.
+     * The scan finds the next comma, quote or newline through a 64 bit mask per 64 byte block
+     * (AVX2, SSE2 or scalar), so the bytes in between are never looked at one by one.
+     * Fields are views into the buffer, except quoted ones with "" in them, which are unescaped into
+     * the arena.
+     */
+    class CsvReader
+    {
+    public:
+        CsvReader(string_view text, StringArena& unescaped, bool detectHeader = true, CsvMaskFn kernel = csvMaskKernel())
+            : data(text), arena(unescaped), headerCheck(detectHeader), maskOf(kernel) {}
+
+        bool next(vector<string_view>& fields); // false at the end, or on an error
+        int line() const { return recordLine; } // 1 based line the last record (or the error) starts on
+        const string& error() const { return problem; } // empty unless next() stopped on an error
+
+    private:
+        string_view data;
+        StringArena& arena;
+        bool headerCheck;
+        CsvMaskFn maskOf;
+        size_t pos = 0;
+        int currentLine = 1;
+        int recordLine = 0;
+        string problem;
+        size_t blockBase = SIZE_MAX; // data offset of the block in blockMask
+        uint64_t blockMask = 0;
+
+        size_t nextStructural(size_t from);
+        bool readQuoted(size_t contentStart, string_view& value);
+        bool fail(const char* message)
+        {
+            problem = message;
+            return false;
+        }
+    };
+
+    /**
+     * nextStructural
+     *
+     * @return the offset of the first comma, quote or newline at or after from, data.size() if none.
+     */
+    size_t CsvReader::nextStructural(size_t from)
+    {
+        while (true)
+        {
+            size_t base = from & ~static_cast<size_t>(63);
+            if (base >= data.size()) return data.size();
+            if (base != blockBase)
+            {
+                blockBase = base;
+                if (base + 64 <= data.size()) blockMask = maskOf(data.data() + base);
+                else
+                {
+                    // the last partial block, padded with bytes that never match
+                    char tail[64] = {};
+                    memcpy(tail, data.data() + base, data.size() - base);
+                    blockMask = maskOf(tail);
+                }
+            }
+            uint64_t mask = blockMask & (~0ULL << (from - base));
+            if (mask != 0) return base + countTrailingZeros(mask);
+            from = base + 64;
+        }
+    }
+
+    /**
+     * readQuoted
+     *
+     * Reads a quoted field's text up to its closing quote, pos ends up just past that quote.
+     * @param contentStart is just after the opening quote, value gets the unescaped text.
+     */
+    bool CsvReader::readQuoted(size_t contentStart, string_view& value)
+    {
+        bool escaped = false;
+        size_t i = contentStart;
+        while (true)
+        {
+            i = nextStructural(i);
+            if (i >= data.size()) return fail("Unterminated quoted field.");
+            if (data[i] == '"')
+            {
+                if (i + 1 < data.size() && data[i + 1] == '"')
+                {
+                    escaped = true;
+                    i += 2;
+                    continue;
+                }
+                break;
+            }
+            if (data[i] == '\n') currentLine++;
+            i++;
+        }
+        value = data.substr(contentStart, i - contentStart);
+        pos = i + 1;
+        if (escaped)
+        {
+            // every "" becomes one quote
+            char* text = static_cast<char*>(arena.allocate(value.size(), 1));
+            size_t length = 0;
+            for (size_t k = 0; k < value.size(); k++)
+            {
+                text[length++] = value[k];
+                if (value[k] == '"') k++;
+            }
+            value = string_view(text, length);
+        }
+        return true;
+    }
+
+    /**
+     * next
+     *
+     * Reads the next record.
+     * @param fields is cleared and gets the record's fields.
+     * @return true if there was a record, false at the end of the data or on an error (see error()).
+     */
+    bool CsvReader::next(vector<string_view>& fields)
+    {
+        while (problem.empty() && pos < data.size())
+        {
+            fields.clear();
+            recordLine = currentLine;
+            bool quoted = false;
+            char end = ',';
+            while (end == ',')
+            {
+                size_t start = pos;
+                while (start < data.size() && (data[start] == ' ' || data[start] == '\t')) start++;
+                quoted = start < data.size() && data[start] == '"';
+                if (quoted)
+                {
+                    string_view value;
+                    if (!readQuoted(start + 1, value)) return false;
+                    fields.push_back(value);
+                    // only blanks between the closing quote and the comma or newline
+                    while (pos < data.size() && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r')) pos++;
+                    if (pos < data.size() && data[pos] != ',' && data[pos] != '\n') return fail("Unexpected text after a quoted field.");
+                }
+                else
+                {
+                    pos = nextStructural(start);
+                    if (pos < data.size() && data[pos] == '"') return fail("Quote inside an unquoted field.");
+                    fields.push_back(trimView(data.substr(start, pos - start)));
+                }
+                end = pos < data.size() ? data[pos] : '\n';
+                pos++;
+            }
+            currentLine++;
+            // blank line, CRLF ones included
+            if (fields.size() == 1 && !quoted && fields[0].empty()) continue;
+            if (headerCheck)
+            {
+                headerCheck = false;
+                if (isHeaderField(fields[0])) continue;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * appendCsvField
+     *
+     * Writes a field the way CsvReader reads it back: as is, or quoted with its quotes doubled
+     * when it holds a comma, a quote or a line break.
+     * @param out gets the field, field is the text.
+     */
+    void appendCsvField(string& out, string_view field)
+    {
+        if (field.find_first_of(",\"\r\n") == string_view::npos)
+        {
+            out.append(field);
+            return;
+        }
+        out += '"';
+        for (char c : field)
+        {
+            if (c == '"') out += '"';
+            out += c;
+        }
+        out += '"';
+    }
+
+    /**
+     * SlabPool
+     *
+     * Fixed size objects handed out from slabs of SLAB_ITEMS, used for the hash table's chain nodes.
+     * Released objects go on a free list for the next acquire. Reset() takes everything back at
+     * once and keeps the slabs, so a reload doesn't free or allocate anything per object.
+     */
+    template <typename T>
+    class SlabPool
+    {
+    public:
+        // a default constructed T
+        T* acquire()
+        {
+            T* item;
+            if (!freed.empty())
+            {
+                item = freed.back();
+                freed.pop_back();
+            }
+            else
+            {
+                if (used == slabs.size() * SLAB_ITEMS)
+                {
+                    slabs.emplace_back(new T[SLAB_ITEMS]);
+                    metrics().addBytes(sizeof(T) * SLAB_ITEMS);
+                }
+                item = &slabs[used / SLAB_ITEMS][used % SLAB_ITEMS];
+                used++;
+            }
+            *item = T();
+            return item;
+        }
+
+        void release(T* item) { freed.push_back(item); }
+
+        // forget every object handed out, the slabs are kept for reuse
+        void Reset()
+        {
+            used = 0;
+            freed.clear();
+        }
+
+        size_t bytesReserved() const { return slabs.size() * SLAB_ITEMS * sizeof(T) + freed.capacity() * sizeof(T*); }
+
+    private:
+        static constexpr size_t SLAB_ITEMS = 1024;
+        vector<unique_ptr<T[]>> slabs;
+        vector<T*> freed;
+        size_t used = 0; // objects handed out from the slabs so far, released ones included
+    };
+
+    /**
+     * MappedFile
+     *
+     * Read-only memory mapping of a whole file, unmapped when it goes out of scope.
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile() { close(); }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // randomAccess for files that are queried in place instead of read front to back once
+        bool open(const string& path, bool randomAccess = false)
+        {
+            close();
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                randomAccess ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize))
+            {
+                close();
+                return false;
+            }
+            size = static_cast<size_t>(fileSize.QuadPart);
+            // an empty file can't be mapped, it's just an empty view
+            if (size == 0) return true;
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping == nullptr)
+            {
+                close();
+                return false;
+            }
+            data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (data == nullptr)
+            {
+                close();
+                return false;
+            }
+#else
+            fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat info;
+            if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+            {
+                close();
+                return false;
+            }
+            size = static_cast<size_t>(info.st_size);
+            // an empty file can't be mapped, it's just an empty view
+            if (size == 0) return true;
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED)
+            {
+                close();
+                return false;
+            }
+            data = static_cast<const char*>(mapped);
+            madvise(mapped, size, randomAccess ? MADV_RANDOM : MADV_SEQUENTIAL);
+#endif
+            return true;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if (data != nullptr) UnmapViewOfFile(data);
+            if (mapping != nullptr) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            mapping = nullptr;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (data != nullptr) munmap(const_cast<char*>(data), size);
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+#endif
+            data = nullptr;
+            size = 0;
+        }
+
+        string_view view() const { return string_view(data, size); }
+
+    private:
+        const char* data = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int fd = -1;
+#endif
+    };
+
+    /**
+     * SnapshotChecksum
+     *
+     * Checksum of a snapshot file, fed whole 64 bit words. Four lanes take turns so the multiplies
+     * don't wait on each other, which keeps it near memory speed on a multi hundred MB file.
+     */
+    class SnapshotChecksum
+    {
+    public:
+        // bytes is a multiple of 8, snapshot sections are padded to it
+        void add(const void* data, size_t bytes)
+        {
+            const char* words = static_cast<const char*>(data);
+            for (size_t i = 0; i + 8 <= bytes; i += 8)
+            {
+                uint64_t word;
+                memcpy(&word, words + i, 8);
+                uint64_t& lane = lanes[count++ & 3];
+                lane = (lane ^ word) * 0x9E3779B97F4A7C15ULL;
+                lane = (lane << 31) | (lane >> 33);
+            }
+        }
+
+        uint64_t value() const
+        {
+            uint64_t h = count;
+            for (uint64_t lane : lanes)
+            {
+                h = (h ^ lane) * 0xff51afd7ed558ccdULL;
+                h ^= h >> 33;
+            }
+            return h;
+        }
+
+    private:
+        uint64_t lanes[4] = { 1, 2, 3, 4 };
+        uint64_t count = 0;
+    };
+
+    /**
+     * snapshotBodyChecksum
+     *
+     * Checksum of everything after a snapshot's header: every SNAPSHOT_BLOCK is checksummed on its
+     * own, spread over the threads, then the block values are checksummed in order.
+     * @param body bytes, a multiple of 8.
+     * @return the checksum stored in the header.
+     */
+    uint64_t snapshotBodyChecksum(string_view body)
+    {
+        size_t blocks = (body.size() + SNAPSHOT_BLOCK - 1) / SNAPSHOT_BLOCK;
+        vector<uint64_t> values(blocks);
+        parallelFor(blocks, [&](size_t b)
+            {
+                SnapshotChecksum block;
+                size_t start = b * SNAPSHOT_BLOCK;
+                block.add(body.data() + start, min(SNAPSHOT_BLOCK, body.size() - start));
+                values[b] = block.value();
+            });
+        SnapshotChecksum total;
+        total.add(values.data(), values.size() * sizeof(uint64_t));
+        return total.value();
+    }
+}
+
+// dense 32 bit id for an interned course number
+using CourseId = uint32_t;
+constexpr CourseId INVALID_COURSE_ID = UINT32_MAX;
+
+/**
+    * Structure for course data
+    */
+struct Course
+{
+    string courseNumber; // unique identifier -- key for hashing
+    string name; // the course title/name
+    vector<string> prerequisites; // list of prerequisite course numbers, the display form
+    // filled in by CourseHashTable: the interned ids of the course and its prerequisites
+    CourseId id = INVALID_COURSE_ID;
+    vector<CourseId> prerequisiteIds;
+
+    // default constructor
+    Course() = default;
+};
+
+/**
+ * CourseView
+ *
+ * Non-owning view of a stored course, returned by CourseHashTable::findCourse instead of a copy.
+ * It points into the table, so it's only valid until the table is next modified (Insert, Clear).
+ * Prerequisite ids turn into course numbers with CourseHashTable::courseNumberOf.
+ */
+struct CourseView
+{
+    string_view courseNumber; // empty when the course wasn't found
+    string_view name;
+    const CourseId* prerequisiteIds = nullptr;
+    size_t prerequisiteCount = 0;
+    CourseId id = INVALID_COURSE_ID;
+
+    explicit operator bool() const { return !courseNumber.empty(); }
+};
+
+/**
+ * CourseKey
+ *
+ * Fixed 16 byte course number key. Numbers under 16 characters, all the real ones like CSCI300,
+ * are stored inline: the characters zero padded, the length in the last byte. Equality is then
+ * two word compares, ordering two byte swapped word compares and the hash two multiplies.
+ * Longer numbers keep a pointer to characters stored elsewhere (the table's arena, or the caller's
+ * string for a lookup key) with 0xFF in the last byte, and fall back to string compares.
+ * Trivially copyable, so records holding one can be memcpy'd and moved between arrays.
+ */
+class CourseKey
+{
+public:
+    CourseKey() : words{ 0, 0 } {}
+    explicit CourseKey(string_view courseNumber)
+    {
+        if (courseNumber.size() < 16)
+        {
+            packShortKey(courseNumber.data(), courseNumber.size(), words);
+            return;
+        }
+        words[0] = reinterpret_cast<uintptr_t>(courseNumber.data());
+        words[1] = courseNumber.size() | LONG_TAG;
+    }
+
+    bool isLong() const { return (words[1] & TAG_MASK) == LONG_TAG; }
+    size_t size() const { return isLong() ? static_cast<size_t>(words[1] & ~TAG_MASK) : static_cast<size_t>(words[1] >> 56); }
+    // the characters, an inline key's point into the key itself
+    string_view view() const
+    {
+        if (isLong()) return string_view(reinterpret_cast<const char*>(static_cast<uintptr_t>(words[0])), size());
+        return string_view(reinterpret_cast<const char*>(words), size());
+    }
+    // same value as hashKey64(view(), seed)
+    uint64_t hash(uint64_t seed = 0) const { return isLong() ? hashKey64(view(), seed) : hashShortKey(words, seed); }
+
+    bool operator==(const CourseKey& other) const
+    {
+        if (words[1] != other.words[1]) return false;
+        return words[0] == other.words[0] || (isLong() && view() == other.view());
+    }
+    bool operator!=(const CourseKey& other) const { return !(*this == other); }
+    // same order as comparing the course number strings
+    bool operator<(const CourseKey& other) const
+    {
+        if (isLong() || other.isLong()) return view() < other.view();
+        uint64_t a = byteSwap(words[0]), b = byteSwap(other.words[0]);
+        if (a != b) return a < b;
+        // the length is the lowest byte after the swap, so a prefix sorts first
+        return byteSwap(words[1]) < byteSwap(other.words[1]);
+    }
+
+private:
+    static constexpr uint64_t TAG_MASK = 0xFFULL << 56;
+    static constexpr uint64_t LONG_TAG = 0xFFULL << 56;
+
+    uint64_t words[2];
+};
+
+// hash functor for unordered containers of CourseKey
+struct CourseKeyHash
+{
+    size_t operator()(const CourseKey& key) const { return static_cast<size_t>(key.hash()); }
+};
+
+/**
+ * CourseIdTable
+ *
+ * Interns course numbers: each distinct number gets the next dense id, starting at 0,
+ * the first time it's seen as a course or as a prerequisite. Ids index plain arrays,
+ * so prerequisite edges are integers and the strings are only kept here for display.
+ */
+class CourseIdTable
+{
+public:
+    // id for the course number, a new one if it's not interned yet
+    CourseId intern(string_view courseNumber)
+    {
+        auto found = ids.find(CourseKey(courseNumber));
+        if (found != ids.end()) return found->second;
+        CourseId id = static_cast<CourseId>(numbers.size());
+        string_view stored = strings.store(courseNumber);
+        numbers.push_back(stored);
+        // a long key points at the stored copy, not the caller's string
+        ids.emplace(CourseKey(stored), id);
+        return id;
+    }
+
+    // id for the course number, INVALID_COURSE_ID if it was never interned
+    CourseId find(string_view courseNumber) const { return find(CourseKey(courseNumber)); }
+    CourseId find(const CourseKey& key) const
+    {
+        auto found = ids.find(key);
+        return found != ids.end() ? found->second : INVALID_COURSE_ID;
+    }
+
+    string_view courseNumber(CourseId id) const { return numbers[id]; }
+    // the key for an interned id, long ones point into the arena
+    CourseKey key(CourseId id) const { return CourseKey(numbers[id]); }
+    size_t size() const { return numbers.size(); }
+    // estimate, the map's node layout is up to the standard library
+    size_t memoryBytes() const
+    {
+        return strings.bytesReserved() + numbers.capacity() * sizeof(string_view) + ids.bucket_count() * sizeof(void*)
+            + ids.size() * (sizeof(pair<const CourseKey, CourseId>) + 2 * sizeof(void*));
+    }
+    void reserve(size_t count)
+    {
+        ids.reserve(count);
+        numbers.reserve(count);
+    }
+
+    void Clear()
+    {
+        ids.clear();
+        numbers.clear();
+        strings.Reset();
+    }
+
+private:
+    unordered_map<CourseKey, CourseId, CourseKeyHash> ids; // long keys point into strings
+    vector<string_view> numbers; // indexed by id
+    StringArena strings;
+};
+
+/**
+ * How the chained storage turns a course number into a bucket.
+ * Polynomial is the original h * 31 + c over a prime bucket count, reduced with %.
+ * Word is hashKey64 (optionally seeded) over a power of two bucket count, reduced with a mask.
+ * Flat and snapshot storage always use hashKey64, they need its tag and check bits.
+ */
+enum class HashPolicy
+{
+    Polynomial,
+    Word
+};
+
+/**
+ * HashStats
+ *
+ * How well the keys spread over a table: collisions are keys whose home bucket (or home slot) an
+ * earlier key already had, compared with what a uniformly random hash gives at the same load.
+ */
+struct HashStats
+{
+    size_t buckets = 0; // bucket or slot count
+    size_t keys = 0;
+    size_t homes = 0; // distinct home buckets or slots
+    size_t collisions = 0; // keys - homes
+    double randomCollisions = 0.0; // expected collisions for a random hash
+    size_t longest = 0; // longest chain, or the most slots a lookup reads
+    double meanProbes = 0.0; // keys compared (chained) or slots read (flat) per hit, over every key
+};
+
+/**
+ * Storage backends for the hash table.
+ * Chained is the original bucket + node chain table, Flat is open addressing over contiguous arrays.
+ * Snapshot is a memory mapped snapshot file queried in place, read only until the first change.
+ */
+enum class StorageMode
+{
+    Chained,
+    Flat,
+    Snapshot
+};
+
+//============================================================================
+// Title search index
+//============================================================================
+
+/**
+ * TitleIndex
+ *
+ * Keyword search over course names. Names are split into lower case words, every distinct word
+ * gets an id and a posting list of the courses whose name has it. The words are indexed again
+ * by trigram ("$algo..." style, padded with $), so a misspelled query word finds the words
+ * within a small edit distance without scanning the vocabulary.
+ */
+class TitleIndex
+{
+public:
+    // a vocabulary word one query word matched, and how well: 1 exact, 0.8 prefix, 0.6/0.4 typo
+    struct Variant
+    {
+        uint32_t word;
+        float quality;
+    };
+
+    // adds the course to the posting list of every distinct word of its name
+    void add(CourseId id, string_view name)
+    {
+        tokenize(name, scratch);
+        for (const string& text : scratch)
+        {
+            uint32_t word = wordId(text);
+            vector<CourseId>& list = postingLists[word];
+            // ids mostly come in ascending order, only the lists that don't get sorted later
+            if (!list.empty() && list.back() > id && !unsorted[word])
+            {
+                unsorted[word] = true;
+                dirtyWords.push_back(word);
+            }
+            list.push_back(id);
+        }
+    }
+
+    // takes the course out of the posting lists of the words of name (a name it was added with)
+    void remove(CourseId id, string_view name)
+    {
+        tokenize(name, scratch);
+        for (const string& text : scratch)
+        {
+            auto found = wordIds.find(text);
+            if (found == wordIds.end()) continue;
+            vector<CourseId>& list = postingLists[found->second];
+            auto position = find(list.begin(), list.end(), id);
+            if (position != list.end()) list.erase(position);
+        }
+    }
+
+    // sorts the posting lists and vocabulary changed since the last call, before querying
+    void prepare()
+    {
+        for (uint32_t word : dirtyWords)
+        {
+            sort(postingLists[word].begin(), postingLists[word].end());
+            unsorted[word] = false;
+        }
+        dirtyWords.clear();
+        if (sortedWords.size() != vocabulary.size())
+        {
+            sortedWords.resize(vocabulary.size());
+            for (uint32_t word = 0; word < vocabulary.size(); word++) sortedWords[word] = word;
+            sort(sortedWords.begin(), sortedWords.end(), [this](uint32_t a, uint32_t b)
+                {
+                    return vocabulary[a] < vocabulary[b];
+                });
+        }
+    }
+
+    void Clear()
+    {
+        wordIds.clear();
+        vocabulary.clear();
+        postingLists.clear();
+        unsorted.clear();
+        dirtyWords.clear();
+        sortedWords.clear();
+        trigramWords.clear();
+        strings.Reset();
+    }
+
+    /**
+     * variants
+     *
+     * Vocabulary words a lower case query word matches: itself, longer words it's a prefix of
+     * (3+ characters), and words within edit distance 1 (4+ characters) or 2 (8+ characters).
+     * Best matches first, at most MAX_VARIANTS.
+     */
+    void variants(string_view query, vector<Variant>& out) const
+    {
+        out.clear();
+        auto exact = wordIds.find(query);
+        if (exact != wordIds.end()) out.push_back({ exact->second, 1.0f });
+
+        if (query.size() >= 3)
+        {
+            auto first = lower_bound(sortedWords.begin(), sortedWords.end(), query, [this](uint32_t word, string_view key)
+                {
+                    return vocabulary[word] < key;
+                });
+            for (auto it = first; it != sortedWords.end() && out.size() < MAX_VARIANTS; ++it)
+            {
+                string_view text = vocabulary[*it];
+                if (text.substr(0, query.size()) != query) break;
+                if (text.size() > query.size()) out.push_back({ *it, 0.8f });
+            }
+        }
+
+        if (query.size() >= 4 && out.size() < MAX_VARIANTS)
+        {
+            size_t maxDistance = query.size() >= 8 ? 2 : 1;
+            // one edit changes at most 3 trigrams (4 for a swap), so a match shares all but 4 per edit
+            size_t needed = query.size() > 4 * maxDistance ? query.size() - 4 * maxDistance : 1;
+            unordered_map<uint32_t, uint32_t> shared;
+            forEachTrigram(query, [&](uint32_t code)
+                {
+                    auto found = trigramWords.find(code);
+                    if (found == trigramWords.end()) return;
+                    for (uint32_t word : found->second) shared[word]++;
+                });
+            vector<Variant> typos;
+            for (const auto& candidate : shared)
+            {
+                if (candidate.second < needed) continue;
+                size_t distance = editDistance(query, vocabulary[candidate.first], maxDistance);
+                if (distance == 0 || distance > maxDistance) continue;
+                typos.push_back({ candidate.first, distance == 1 ? 0.6f : 0.4f });
+            }
+            // the map's order isn't stable, keep results the same from run to run
+            sort(typos.begin(), typos.end(), [](const Variant& a, const Variant& b)
+                {
+                    return a.quality != b.quality ? a.quality > b.quality : a.word < b.word;
+                });
+            for (const Variant& typo : typos)
+            {
+                if (out.size() >= MAX_VARIANTS) break;
+                bool seen = false;
+                for (const Variant& variant : out) seen = seen || variant.word == typo.word;
+                if (!seen) out.push_back(typo);
+            }
+        }
+    }
+
+    // courses whose name has the word, ascending ids once prepare() ran
+    const vector<CourseId>& postings(uint32_t word) const { return postingLists[word]; }
+
+    // splits text into its distinct lower case words of 2+ letters or digits
+    static void tokenize(string_view text, vector<string>& words)
+    {
+        words.clear();
+        string word;
+        for (size_t i = 0; i <= text.size(); i++)
+        {
+            unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+            if (isalnum(c))
+            {
+                word += static_cast<char>(tolower(c));
+                continue;
+            }
+            if (word.size() >= 2 && find(words.begin(), words.end(), word) == words.end()) words.push_back(word);
+            word.clear();
+        }
+    }
+
+    size_t memoryBytes() const
+    {
+        size_t bytes = strings.bytesReserved() + vocabulary.capacity() * sizeof(string_view) + sortedWords.capacity() * 4;
+        for (const vector<CourseId>& list : postingLists) bytes += sizeof(list) + list.capacity() * sizeof(CourseId);
+        for (const auto& entry : trigramWords) bytes += sizeof(entry) + entry.second.capacity() * 4;
+        return bytes + wordIds.size() * (sizeof(pair<const string_view, uint32_t>) + 2 * sizeof(void*));
+    }
+
+private:
+    static constexpr size_t MAX_VARIANTS = 32;
+
+    unordered_map<string_view, uint32_t> wordIds; // keys point into strings
+    vector<string_view> vocabulary; // indexed by word id
+    vector<vector<CourseId>> postingLists; // indexed by word id
+    vector<char> unsorted; // per word, set while its posting list is out of order
+    vector<uint32_t> dirtyWords; // the unsorted ones
+    vector<uint32_t> sortedWords; // word ids in text order, for prefix matches
+    unordered_map<uint32_t, vector<uint32_t>> trigramWords; // packed trigram to word ids
+    StringArena strings;
+    vector<string> scratch;
+
+    uint32_t wordId(const string& text)
+    {
+        auto found = wordIds.find(text);
+        if (found != wordIds.end()) return found->second;
+        uint32_t word = static_cast<uint32_t>(vocabulary.size());
+        string_view stored = strings.store(text);
+        vocabulary.push_back(stored);
+        wordIds.emplace(stored, word);
+        postingLists.emplace_back();
+        unsorted.push_back(false);
+        forEachTrigram(stored, [&](uint32_t code)
+            {
+                vector<uint32_t>& words = trigramWords[code];
+                if (words.empty() || words.back() != word) words.push_back(word);
+            });
+        return word;
+    }
+
+    // calls fn with every trigram of "$text$", packed into the low 24 bits
+    template <typename Fn>
+    static void forEachTrigram(string_view text, Fn fn)
+    {
+        uint32_t code = '$';
+        for (size_t i = 0; i <= text.size(); i++)
+        {
+            unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : '$';
+            code = ((code << 8) | c) & 0xFFFFFF;
+            if (i >= 1) fn(code);
+        }
+    }
+
+    // optimal string alignment distance (edits plus adjacent swaps), anything over limit is limit + 1
+    static size_t editDistance(string_view a, string_view b, size_t limit)
+    {
+        if ((a.size() > b.size() ? a.size() - b.size() : b.size() - a.size()) > limit) return limit + 1;
+        vector<size_t> before(b.size() + 1), previous(b.size() + 1), current(b.size() + 1);
+        for (size_t j = 0; j <= b.size(); j++) previous[j] = j;
+        for (size_t i = 1; i <= a.size(); i++)
+        {
+            current[0] = i;
+            size_t rowMin = current[0];
+            for (size_t j = 1; j <= b.size(); j++)
+            {
+                size_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+                current[j] = min({ previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost });
+                if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                {
+                    current[j] = min(current[j], before[j - 2] + 1);
+                }
+                rowMin = min(rowMin, current[j]);
+            }
+            if (rowMin > limit) return limit + 1;
+            before.swap(previous);
+            previous.swap(current);
+        }
+        return min(previous[b.size()], limit + 1);
+    }
+};
+
+// a ranked search result
+struct SearchHit
+{
+    CourseView course;
+    double score; // 3 exact course number, 2 course number prefix, up to 1 for title words
+};
+
+//============================================================================
+// Rendered course views
+//============================================================================
+
+// course views a table keeps rendered, a few hundred popular courses get most lookups
+constexpr size_t VIEW_CACHE_ENTRIES = 512;
+
+// hit rate and size of a CourseViewCache
+struct ViewCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t invalidations = 0; // views dropped because their course or a course in their chain changed
+    uint64_t evictions = 0; // views dropped to make room
+    size_t entries = 0;
+    size_t capacity = 0;
+    size_t bytes = 0;
+
+    double hitRate() const { return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses); }
+};
+
+/**
+ * CourseViewCache
+ *
+ * Bounded cache of rendered course views by course id (an interned course number). Eviction is
+ * CLOCK: a hit only sets the slot's referenced bit, and when every slot is taken a hand sweeps
+ * them, clearing the bits, until it finds a view nobody asked for since its last pass.
+ * Every view lists the courses it was rendered from, the course and its whole prerequisite chain,
+ * and each of those ids keeps the slots that depend on it, so a change to a course drops exactly
+ * the views that show it. Watches of views that are gone since are skipped by slot generation and
+ * dropped once they outnumber the live ones. Not thread safe, the table locks around it.
+ */
+class CourseViewCache
+{
+public:
+    explicit CourseViewCache(size_t capacity = VIEW_CACHE_ENTRIES) { setCapacity(capacity); }
+
+    // copies the view out on a hit
+    bool find(CourseId id, string& rendered)
+    {
+        auto found = slotOf.find(id);
+        if (found == slotOf.end())
+        {
+            counters.misses++;
+            return false;
+        }
+        Slot& slot = slots[found->second];
+        slot.referenced = true;
+        rendered = slot.rendered;
+        counters.hits++;
+        return true;
+    }
+
+    // chain is every course the view was rendered from, id included
+    void store(CourseId id, string_view rendered, const vector<CourseId>& chain)
+    {
+        if (slots.empty() || slotOf.count(id) > 0) return;
+        uint32_t index = claimSlot();
+        Slot& slot = slots[index];
+        slot.id = id;
+        slot.rendered.assign(rendered);
+        slot.chain = chain;
+        slot.used = true;
+        slot.referenced = false;
+        slotOf.emplace(id, index);
+        for (CourseId course : chain) watchers[course].push_back(Watch{ index, slot.generation });
+        watchCount += chain.size();
+        liveWatches += chain.size();
+        payloadBytes += slot.rendered.capacity() + slot.chain.capacity() * sizeof(CourseId);
+        if (watchCount > 2 * liveWatches + slots.size()) compactWatches();
+    }
+
+    // drops every view the course shows up in, returns how many
+    size_t invalidate(CourseId id)
+    {
+        // nothing cached, e.g. during a load
+        if (slotOf.empty()) return 0;
+        auto found = watchers.find(id);
+        if (found == watchers.end()) return 0;
+        size_t dropped = 0;
+        for (const Watch& watch : found->second)
+        {
+            if (!slots[watch.slot].used || slots[watch.slot].generation != watch.generation) continue;
+            drop(watch.slot);
+            dropped++;
+        }
+        counters.invalidations += dropped;
+        watchCount -= found->second.size();
+        watchers.erase(found);
+        return dropped;
+    }
+
+    // every view goes, the counters stay
+    void clear()
+    {
+        for (uint32_t index = 0; index < slots.size(); index++)
+        {
+            if (!slots[index].used) continue;
+            drop(index);
+            counters.invalidations++;
+        }
+        watchers.clear();
+        watchCount = 0;
+        hand = 0;
+    }
+
+    void setCapacity(size_t capacity)
+    {
+        clear();
+        slots.resize(capacity);
+        slots.shrink_to_fit();
+    }
+
+    // calls fn(id, rendered, chain) for every cached view
+    template <typename Fn>
+    void forEach(Fn fn) const
+    {
+        for (const Slot& slot : slots)
+        {
+            if (slot.used) fn(slot.id, string_view(slot.rendered), slot.chain);
+        }
+    }
+
+    // continues another cache's hit, miss and drop counts, e.g. the catalog this one replaces
+    void carryCounters(const CourseViewCache& previous, uint64_t dropped)
+    {
+        counters = previous.counters;
+        counters.invalidations += dropped;
+    }
+
+    ViewCacheStats statistics() const
+    {
+        ViewCacheStats stats = counters;
+        stats.entries = slotOf.size();
+        stats.capacity = slots.size();
+        stats.bytes = memoryBytes();
+        return stats;
+    }
+
+    // estimate, the maps' node layout is up to the standard library
+    size_t memoryBytes() const
+    {
+        return slots.capacity() * sizeof(Slot) + payloadBytes + watchCount * sizeof(Watch)
+            + (slotOf.bucket_count() + watchers.bucket_count()) * sizeof(void*)
+            + slotOf.size() * (sizeof(pair<const CourseId, uint32_t>) + 2 * sizeof(void*))
+            + watchers.size() * (sizeof(pair<const CourseId, vector<Watch>>) + 2 * sizeof(void*));
+    }
+
+private:
+    struct Slot
+    {
+        CourseId id = INVALID_COURSE_ID;
+        string rendered;
+        vector<CourseId> chain; // the course and everything it requires, what the view shows
+        uint32_t generation = 0; // bumped when the slot is emptied, so old watches are recognized
+        bool used = false;
+        bool referenced = false; // asked for since the hand last passed
+    };
+    // a view that has to go when the watched course changes
+    struct Watch
+    {
+        uint32_t slot;
+        uint32_t generation;
+    };
+
+    vector<Slot> slots;
+    unordered_map<CourseId, uint32_t> slotOf;
+    unordered_map<CourseId, vector<Watch>> watchers; // per course, the views it's in
+    size_t watchCount = 0; // watches in watchers, stale ones included
+    size_t liveWatches = 0; // chain entries of the cached views
+    size_t payloadBytes = 0; // rendered text and chains
+    size_t hand = 0;
+    ViewCacheStats counters;
+
+    // an empty slot, or the first one the hand finds unreferenced
+    uint32_t claimSlot()
+    {
+        while (true)
+        {
+            uint32_t index = static_cast<uint32_t>(hand);
+            hand = (hand + 1) % slots.size();
+            Slot& slot = slots[index];
+            if (!slot.used) return index;
+            if (slot.referenced)
+            {
+                slot.referenced = false;
+                continue;
+            }
+            drop(index);
+            counters.evictions++;
+            return index;
+        }
+    }
+
+    void drop(uint32_t index)
+    {
+        Slot& slot = slots[index];
+        slotOf.erase(slot.id);
+        liveWatches -= slot.chain.size();
+        payloadBytes -= slot.rendered.capacity() + slot.chain.capacity() * sizeof(CourseId);
+        slot.rendered = string();
+        slot.chain = vector<CourseId>();
+        slot.used = false;
+        slot.referenced = false;
+        slot.generation++;
+    }
+
+    // rebuilds the watch lists from the cached views only
+    void compactWatches()
+    {
+        watchers.clear();
+        watchCount = 0;
+        for (uint32_t index = 0; index < slots.size(); index++)
+        {
+            const Slot& slot = slots[index];
+            if (!slot.used) continue;
+            for (CourseId course : slot.chain) watchers[course].push_back(Watch{ index, slot.generation });
+            watchCount += slot.chain.size();
+        }
+    }
+};
+
+//============================================================================
+// Hash Table class definition
+//============================================================================
+
+/**
+ * Hash Table Class
+ *
+ * Contains the Node structure, initializes the vector containing the buckets.
+ * Initializes the table size for the buckets, tracking of the total elements, and max chain length.
+ * It has methods for loading the course data, parsing it, storing it in the data structure.
+ * Then searching for a specific course, printing all courses, or resizing the table size once it holds
+ * more courses than its load factor allows. reserve() sizes it once for a bulk load.
+ * With StorageMode::Flat it uses open addressing instead: a control byte array, a slot array and
+ * a dense array of fixed size records.
+ * Either way, a course is a fixed size record whose name and prerequisite ids live in the table's
+ * arena, and chained nodes come from a slab pool, so Clear() is a reset and not a free per course.
+ */
+class CourseHashTable
+{
+private:
+    // Fixed size course record, the strings and prerequisites point into the arena
+    struct CourseRecord
+    {
+        CourseKey key; // the course number, long ones point at the interned copy
+        string_view name;
+        const CourseId* prerequisites = nullptr; // id array in the arena
+        uint32_t prerequisiteCount = 0;
+        CourseId id = INVALID_COURSE_ID;
+    };
+
+	// Structure for node chaining. Heads live in the bucket vector, chained nodes come from the pool.
+    struct Node
+    {
+        CourseRecord record; // course data, owned by the arena
+        unsigned int key = UINT_MAX; // hash key value, UINT_MAX for an empty bucket
+        Node* next = nullptr; // pointer to the next node in the chain
+    };
+
+    // Flat slot, the upper hash bits filter most mismatches before the key compare
+    struct FlatSlot
+    {
+        uint32_t hash = 0; // upper 32 bits of the key hash
+        uint32_t record = 0; // index into records
+    };
+
+    StorageMode mode;
+    StorageMode baseMode; // mode without a snapshot, where changes go once a snapshot is thawed or cleared
+    HashPolicy policy = HashPolicy::Word; // chained bucket hash
+    uint64_t hashSeed = 0; // seed of hashKey64 for this table
+
+    vector<Node> buckets;
+    // previous bucket array while an incremental resize is running, empty otherwise.
+    // buckets below migrateIndex have already been moved into buckets.
+    vector<Node> oldBuckets;
+    size_t migrateIndex = 0;
+    // these are set in the constructors. 
+    size_t tableSize; // DEFAULT_SIZE is 31 for a small dataset. For flat storage it's the slot count.
+	size_t numElements; // track total elements
+
+    double maxLoadFactor = CHAINED_MAX_LOAD; // grows past this many courses per bucket (or per flat slot)
+
+    SlabPool<Node> nodes; // chained nodes past the bucket heads
+
+    // flat storage, only used with StorageMode::Flat
+    vector<uint8_t> controls; // FLAT_EMPTY or the 7 bit hash tag per slot
+    vector<FlatSlot> slots;
+    vector<CourseRecord> records; // dense, in insertion order
+
+    /**
+     * Snapshot file layout. A fixed header, then sections at 8 byte aligned offsets:
+     * strings (course numbers and names), ids (one SnapshotId per interned id), records (one
+     * SnapshotRecord per course, in course number order), prerequisite ids, and the hash index as
+     * control bytes plus FlatSlots keyed by id, probed like the flat storage. Nothing is decoded on
+     * load, the table points into the mapping.
+     */
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t endianTag; // 0x01020304 as written, a different byte order reads something else
+        uint64_t fileBytes;
+        uint64_t courseCount;
+        uint64_t idCount;
+        uint64_t slotCount; // power of two
+        uint64_t prereqCount;
+        uint64_t stringBytes;
+        uint64_t stringsOffset;
+        uint64_t idsOffset;
+        uint64_t recordsOffset;
+        uint64_t prereqsOffset;
+        uint64_t controlsOffset;
+        uint64_t slotsOffset;
+        uint64_t hashSeed; // hashKey64 seed of the index
+        uint64_t bodyChecksum; // snapshotBodyChecksum of everything after the header
+        uint64_t headerChecksum; // the header with this field zero
+    };
+    struct SnapshotId
+    {
+        uint32_t offset; // course number in the strings section
+        uint32_t length;
+        uint32_t record; // its record, UINT32_MAX when it's only a prerequisite
+    };
+    struct SnapshotRecord
+    {
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t firstPrereq; // index into the prerequisite section
+        uint32_t prereqCount;
+        CourseId id;
+        uint32_t reserved;
+    };
+
+    // snapshot storage, only used with StorageMode::Snapshot, all of it points into the mapping
+    MappedFile snapshotFile;
+    const char* snapStrings = nullptr;
+    const SnapshotId* snapIds = nullptr;
+    const SnapshotRecord* snapRecords = nullptr;
+    const CourseId* snapPrereqs = nullptr;
+    const uint8_t* snapControls = nullptr;
+    const FlatSlot* snapSlots = nullptr;
+    size_t snapIdCount = 0;
+    uint64_t snapSeed = 0; // hash seed the snapshot's index was built with
+
+    StringArena arena; // names and prerequisite arrays of every record, both storage modes
+    vector<CourseId> scratchIds; // prerequisite ids of the course being inserted
+
+    // sorted index for listings: course ids in course number order, plus the ones added since
+    // the last listing. They're merged in on the next listing, so only changes cost a sort.
+    mutable vector<CourseId> sortedIds;
+    mutable vector<CourseId> unsortedIds;
+    mutable vector<CourseId> removedIds; // removed since the last listing, dropped from sortedIds then
+    mutable mutex sortedLock;
+    void ensureSorted() const;
+    CourseView viewById(CourseId id) const;
+
+    // title search index, brought up to date the same way: courses to add, and old names of
+    // indexed courses that were renamed (the old strings stay in the arena until Clear)
+    mutable TitleIndex titles;
+    mutable vector<CourseId> titlePending;
+    mutable vector<pair<CourseId, string_view>> titleRemovals;
+    mutable vector<char> titleIndexed; // per id
+    mutable mutex titleLock;
+    void ensureTitles() const;
+
+    // rendered views of the most asked for courses, see CourseViewCache. Readers share it under the
+    // lock, the inserts, Remove and Clear drop the views they change (writers have the table to themselves)
+    mutable CourseViewCache views;
+    mutable mutex viewLock;
+    void renderView(CourseId id, string& text, vector<CourseId>& chain) const;
+
+    CourseIdTable courseIds; // interned course numbers, shared by both storage modes
+    vector<bool> definedIds; // true for ids that are inserted courses, not just prerequisites
+
+    void storeCourse(CourseId id, string_view name, const CourseId* prerequisites, size_t count);
+    void markDefined(CourseId id);
+    void expandPrerequisites(Course& course) const; // rebuilds the display strings from the ids
+
+    unsigned int hash(const CourseKey& key) const;
+    unsigned int hash(const CourseKey& key, size_t size) const;
+    // hashKey64 with the seed of whatever is being probed
+    uint64_t keyHash(string_view courseNumber) const { return hashKey64(courseNumber, mode == StorageMode::Snapshot ? snapSeed : hashSeed); }
+    uint64_t keyHash(const CourseKey& key) const { return key.hash(mode == StorageMode::Snapshot ? snapSeed : hashSeed); }
+    size_t bucketCountFor(size_t count) const; // prime or power of two, whichever the policy needs
+    size_t capacityFor(size_t courses) const; // buckets or slots that hold courses under maxLoadFactor
+    void reSize(size_t newSize); // dynamic resizing when the load factor is exceeded
+    void migrateBuckets(size_t count); // incremental part of reSize
+    void relink(Node* node); // moves a chained node into the current buckets
+    static const Node* findNode(const Node* head, const CourseKey& key, size_t* probes = nullptr);
+    const Node* chainedFind(const CourseKey& key) const;
+    const Node* chainedFind(const CourseKey& key, unsigned int bucket, size_t* probes = nullptr) const;
+    CourseView lookup(string_view courseNumber) const; // findCourse without the timer
+    CourseRecord& chainedRecordFor(CourseId id);
+    bool chainedRemove(CourseId id);
+
+    void fillRecord(CourseRecord& record, string_view name, const CourseId* prerequisites, size_t count);
+    Course toCourse(const CourseView& view) const;
+    CourseView viewOf(const CourseRecord& record) const;
+
+    // flat storage helpers
+    const CourseRecord* flatFind(const CourseKey& key) const;
+    const CourseRecord* flatFind(const CourseKey& key, uint64_t h, size_t* probes = nullptr) const;
+    CourseRecord& flatRecordFor(CourseId id);
+    bool flatRemove(CourseId id);
+    size_t flatSlotOf(size_t record) const; // the slot that points at a record
+    void flatGrow(size_t newSize);
+    void flatClear();
+
+    // snapshot storage helpers
+    CourseId snapshotFind(string_view courseNumber, uint64_t h, size_t* probes = nullptr) const;
+    CourseView snapshotView(const SnapshotRecord& record) const;
+    void thaw() { if (mode == StorageMode::Snapshot) thawSnapshot(); }
+    void thawSnapshot(); // copies the mapped catalog into baseMode storage before a change
+    void clearIndexes();
+
+public:
+    CourseHashTable(); // default constructor
+    CourseHashTable(unsigned int size); // constructor for resizing
+    explicit CourseHashTable(StorageMode storage, HashPolicy hashPolicy = HashPolicy::Word, uint64_t seed = 0); // constructor for picking the backend
+    ~CourseHashTable(); // destructor
+
+    void Insert(const Course& course);
+    void insertFields(string_view courseNumber, string_view name, const string_view* prerequisites, size_t count);
+    void insertInterned(CourseId id, string_view name, const CourseId* prerequisites, size_t count);
+    bool Remove(string_view courseNumber); // false if it isn't a loaded course
+    void copyFrom(const CourseHashTable& source); // replaces this table's courses with a copy of source's
+    Course searchCourse(const string& courseNumber) const; // copy, kept for compatibility
+    CourseView findCourse(string_view courseNumber) const; // no copy, see CourseView
+    void findMany(const string_view* keys, size_t count, CourseView* results) const; // batched, prefetching
+    void printAll(ostream& out = cout) const;
+    // page of the courses starting with prefix in course number order, returns the total matching
+    size_t listCourses(string_view prefix, size_t offset, size_t limit, vector<CourseView>& page) const;
+    // every course id in course number order, valid until the table is next modified
+    const vector<CourseId>& sortedCourseIds() const
+    {
+        ensureSorted();
+        return sortedIds;
+    }
+    // ranked course number prefix and title keyword matches, typos allowed
+    void searchCourses(string_view query, size_t limit, vector<SearchHit>& hits) const;
+    void buildIndexes() const; // brings the sorted and title indexes up to date now
+    // the course as menu option 3 shows it, with its whole prerequisite chain, false if it isn't a course
+    bool renderedView(string_view courseNumber, string& text) const;
+    // keeps the previous catalog's cached views whose courses are all the same in this one, after a reload
+    void carryViews(const CourseHashTable& previous);
+    void setViewCacheCapacity(size_t entries); // views kept, 0 turns the cache off
+    ViewCacheStats viewCacheStatistics() const;
+    void Clear(); 
+    void finishRehash(); // completes a running incremental resize
+    void reserve(size_t courses); // sizes the table once for about this many courses, e.g. before a bulk load
+    void setMaxLoadFactor(double load); // growth threshold, courses per bucket or full slots per flat slot
+    double MaxLoadFactor() const { return maxLoadFactor; }
+    size_t Size() const { return numElements; }
+    StorageMode Mode() const { return mode; }
+    size_t bucketCount() const { return tableSize; } // buckets, or slots for flat storage
+    size_t arenaBytes() const { return arena.bytesUsed(); }
+    size_t memoryBytes() const; // everything the table holds, for memory per course
+    vector<size_t> chainLengths() const; // buckets per chain length, or slots per probe distance for flat
+    HashStats hashStatistics() const; // collisions and probe lengths, to compare hash policies
+    HashPolicy Policy() const { return policy; }
+    uint64_t Seed() const { return mode == StorageMode::Snapshot ? snapSeed : hashSeed; }
+
+    // binary snapshot of the catalog, see SnapshotHeader. Loading maps the file and queries it in
+    // place, verify also checks the body checksum (reads the whole file once)
+    bool saveSnapshot(const string& path) const;
+    bool loadSnapshot(const string& path, bool verify = true);
+
+    // interned ids, valid until Clear()
+    CourseId intern(string_view courseNumber)
+    {
+        thaw();
+        return courseIds.intern(courseNumber);
+    }
+    CourseId idOf(string_view courseNumber) const
+    {
+        if (mode == StorageMode::Snapshot) return snapshotFind(courseNumber, keyHash(courseNumber));
+        return courseIds.find(courseNumber);
+    }
+    string_view courseNumberOf(CourseId id) const
+    {
+        if (mode == StorageMode::Snapshot) return string_view(snapStrings + snapIds[id].offset, snapIds[id].length);
+        return courseIds.courseNumber(id);
+    }
+    size_t idCount() const { return mode == StorageMode::Snapshot ? snapIdCount : courseIds.size(); }
+    // O(1) check that an id is a loaded course and not only referenced as a prerequisite
+    bool isCourse(CourseId id) const
+    {
+        if (mode == StorageMode::Snapshot) return id < snapIdCount && snapIds[id].record != UINT32_MAX;
+        return id < definedIds.size() && definedIds[id];
+    }
+
+    /**
+     * forEachCourse
+     *
+     * Calls fn(id, prerequisiteIds, prerequisiteCount) for every stored course, in storage order.
+     * Used to build the indexes that sit on top of the table, like the prerequisite graph.
+     */
+    template <typename Fn>
+    void forEachCourse(Fn fn) const
+    {
+        if (mode == StorageMode::Snapshot)
+        {
+            for (size_t r = 0; r < numElements; r++)
+            {
+                const SnapshotRecord& record = snapRecords[r];
+                fn(record.id, snapPrereqs + record.firstPrereq, static_cast<size_t>(record.prereqCount));
+            }
+            return;
+        }
+        if (mode == StorageMode::Flat)
+        {
+            for (const CourseRecord& record : records)
+            {
+                fn(record.id, record.prerequisites, static_cast<size_t>(record.prerequisiteCount));
+            }
+            return;
+        }
+        for (const vector<Node>* table : { &buckets, &oldBuckets })
+        {
+            for (const Node& bucket : *table)
+            {
+                if (bucket.key == UINT_MAX) continue;
+                for (const Node* node = &bucket; node != nullptr; node = node->next)
+                {
+                    fn(node->record.id, node->record.prerequisites, static_cast<size_t>(node->record.prerequisiteCount));
+                }
+            }
+        }
+    }
+
+    /**
+     * forEachView
+     *
+     * Calls fn(view) for every stored course, in storage order, with the name as well as the ids.
+     */
+    template <typename Fn>
+    void forEachView(Fn fn) const
+    {
+        if (mode == StorageMode::Snapshot)
+        {
+            for (size_t r = 0; r < numElements; r++) fn(snapshotView(snapRecords[r]));
+            return;
+        }
+        if (mode == StorageMode::Flat)
+        {
+            for (const CourseRecord& record : records) fn(viewOf(record));
+            return;
+        }
+        for (const vector<Node>* table : { &buckets, &oldBuckets })
+        {
+            for (const Node& bucket : *table)
+            {
+                if (bucket.key == UINT_MAX) continue;
+                for (const Node* node = &bucket; node != nullptr; node = node->next) fn(viewOf(node->record));
+            }
+        }
+    }
+};
+
+/**
+ * Default constructor
+ * Creates a hash table with DEFAULT_SIZE (31) buckets, 32 with the default HashPolicy::Word.
+ * And sets the numElements for counting.
+ */
+CourseHashTable::CourseHashTable() : mode(StorageMode::Chained), baseMode(StorageMode::Chained), numElements(0)
+{
+    tableSize = bucketCountFor(DEFAULT_SIZE);
+    buckets.resize(tableSize);
+}
+
+/**
+ * Size constructor
+ * For a table with a known number of buckets up front.
+ * The size is rounded up to a power of two for HashPolicy::Word.
+ */
+CourseHashTable::CourseHashTable(unsigned int size) : mode(StorageMode::Chained), baseMode(StorageMode::Chained), numElements(0)
+{
+    tableSize = bucketCountFor(size);
+    buckets.resize(tableSize);
+}
+
+/**
+ * Storage constructor
+ * Chained behaves like the default constructor, Flat starts with FLAT_DEFAULT_CAPACITY empty slots.
+ * hashPolicy picks the chained bucket hash, seed the hashKey64 seed of either storage.
+ */
+CourseHashTable::CourseHashTable(StorageMode storage, HashPolicy hashPolicy, uint64_t seed)
+    : mode(storage), policy(hashPolicy), hashSeed(seed), numElements(0)
+{
+    tableSize = bucketCountFor(DEFAULT_SIZE);
+    // a snapshot table is a flat one until loadSnapshot maps a file
+    if (mode == StorageMode::Snapshot) mode = StorageMode::Flat;
+    baseMode = mode;
+    if (mode == StorageMode::Flat)
+    {
+        maxLoadFactor = FLAT_MAX_LOAD;
+        tableSize = FLAT_DEFAULT_CAPACITY;
+        controls.assign(tableSize, FLAT_EMPTY);
+        slots.resize(tableSize);
+    }
+    else
+    {
+        buckets.resize(tableSize);
+    }
+}
+
+/**
+ * Destructor
+ * Frees all dynamically allocated memory
+ */
+CourseHashTable::~CourseHashTable() {
+    // nothing to walk, the node pool, the arena and the vectors free their blocks themselves
+}
+
+/**
+ * findNode
+ *
+ * Walks one bucket chain.
+ * @param head of the bucket, key to look for.
+ * @return the node holding the course, or nullptr.
+ */
+const CourseHashTable::Node* CourseHashTable::findNode(const Node* head, const CourseKey& key, size_t* probes)
+{
+    if (head->key == UINT_MAX) return nullptr;
+    for (const Node* node = head; node != nullptr; node = node->next)
+    {
+        if (probes != nullptr) (*probes)++;
+        if (node->record.key == key) return node;
+    }
+    return nullptr;
+}
+
+/**
+ * Hash function
+ * 
+ * @param key of the course is passed, then it evaluates a new hash value
+ * @return the new hash value
+ */
+unsigned int CourseHashTable::hash(const CourseKey& key) const
+{
+    return hash(key, tableSize);
+}
+
+/**
+ * Hash function for a given bucket count, used for the old array during an incremental resize.
+ */
+unsigned int CourseHashTable::hash(const CourseKey& key, size_t size) const
+{
+    if (policy == HashPolicy::Word)
+    {
+        // power of two bucket count, so the mask is the whole range reduction
+        return static_cast<unsigned int>(keyHash(key) & (size - 1));
+    }
+    // simple polynomial string hash works better to avoid issues like 101 being used for multiple courses
+    unsigned int hashValue = 0;
+    for (char currChar : key.view()) {
+        hashValue = hashValue * 31 + currChar;
+    }
+    return hashValue % size;
+}
+
+/**
+ * bucketCountFor
+ *
+ * @return the smallest usable bucket count of at least count: a prime for HashPolicy::Polynomial,
+ * a power of two for HashPolicy::Word.
+ */
+size_t CourseHashTable::bucketCountFor(size_t count) const
+{
+    if (policy == HashPolicy::Polynomial) return nextPrime(static_cast<unsigned int>(count));
+    size_t rounded = 1;
+    while (rounded < count) rounded *= 2;
+    return rounded;
+}
+
+/**
+ * capacityFor
+ *
+ * @return the bucket count (chained) or slot count (flat) that holds courses without going over
+ * maxLoadFactor, never less than a new table has.
+ */
+size_t CourseHashTable::capacityFor(size_t courses) const
+{
+    size_t needed = static_cast<size_t>(ceil(static_cast<double>(courses) / maxLoadFactor));
+    if (baseMode == StorageMode::Flat)
+    {
+        size_t capacity = FLAT_DEFAULT_CAPACITY;
+        // at least one empty slot, probing stops there
+        while (capacity < needed || capacity <= courses) capacity *= 2;
+        return capacity;
+    }
+    return bucketCountFor(max<size_t>(needed, DEFAULT_SIZE));
+}
+
+/**
+ * reSize
+ * To automatically resize the hash table when it holds more than maxLoadFactor courses per bucket.
+ * It's incremental: the current buckets become oldBuckets, a new bigger array takes their place,
+ * and every Insert moves REHASH_STEP old buckets over until none are left. Lookups check both
+ * arrays meanwhile. So no single Insert pays for rehashing the whole table.
+ * @param newSize bucket count, from bucketCountFor.
+ */
+
+void CourseHashTable::reSize(size_t newSize)
+{
+    // one resize at a time, the next Insert triggers again after the migration if it's still too full
+    if (!oldBuckets.empty()) return;
+    ScopedTimer timer(Op::ReSize);
+    metrics().resizes++;
+
+    cout << "Resizing hash table from " << tableSize << " to " << newSize << " buckets.\n";
+
+    // keep the current buckets around and start over with the new size
+    oldBuckets = move(buckets);
+    buckets = vector<Node>(newSize);
+    metrics().addBytes(newSize * sizeof(Node));
+    tableSize = newSize;
+    migrateIndex = 0;
+}
+
+/**
+ * migrateBuckets
+ *
+ * Moves up to count old buckets into the current array. Records are small and point into the
+ * arena, so nothing but the record itself is copied, and chained nodes are relinked.
+ * @param count of old buckets to move.
+ */
+void CourseHashTable::migrateBuckets(size_t count)
+{
+    size_t end = min(oldBuckets.size(), migrateIndex + count);
+    size_t moved = 0;
+    for (; migrateIndex < end; migrateIndex++)
+    {
+        Node& head = oldBuckets[migrateIndex];
+        if (head.key == UINT_MAX) continue;
+
+        // detach the chain first, relink reuses the nodes
+        Node* current = head.next;
+        head.next = nullptr;
+        while (current != nullptr)
+        {
+            Node* next = current->next;
+            relink(current);
+            current = next;
+            moved++;
+        }
+        moved++;
+
+        // the head lives in the old vector, so its record gets a pool node (or an empty head)
+        unsigned int key = hash(head.record.key);
+        Node& target = buckets[key];
+        if (target.key == UINT_MAX)
+        {
+            target.key = key;
+            target.record = head.record;
+        }
+        else
+        {
+            Node* node = nodes.acquire();
+            node->record = head.record;
+            node->key = key;
+            node->next = target.next;
+            target.next = node;
+        }
+        head.key = UINT_MAX;
+    }
+    metrics().rehashedBytes += moved * sizeof(Node);
+
+    // all moved, drop the old array
+    if (migrateIndex >= oldBuckets.size())
+    {
+        vector<Node>().swap(oldBuckets);
+        migrateIndex = 0;
+    }
+}
+
+/**
+ * relink
+ *
+ * Puts an existing chained node into its bucket in the current array.
+ */
+void CourseHashTable::relink(Node* node)
+{
+    unsigned int key = hash(node->record.key);
+    Node& target = buckets[key];
+    if (target.key == UINT_MAX)
+    {
+        // empty head, the record moves into the vector and the node goes back to the pool
+        target.key = key;
+        target.record = node->record;
+        nodes.release(node);
+        return;
+    }
+    node->key = key;
+    node->next = target.next;
+    target.next = node;
+}
+
+/**
+ * finishRehash
+ *
+ * Moves whatever is left of a running resize, e.g. at the end of a load so lookups
+ * only check one array afterwards.
+ */
+void CourseHashTable::finishRehash()
+{
+    if (!oldBuckets.empty()) migrateBuckets(oldBuckets.size());
+}
+
+/**
+ * reserve
+ *
+ * Bulk build: sizes the buckets (or flat slots), the record array and the id table once for
+ * courses, so a load of that many doesn't resize on the way. An empty table just gets bigger
+ * arrays, one that holds courses is rehashed in one go. Never shrinks, and an estimate is fine,
+ * past it the table grows by load factor as usual.
+ * @param courses expected number of courses.
+ */
+void CourseHashTable::reserve(size_t courses)
+{
+    thaw();
+    courseIds.reserve(courses);
+    definedIds.reserve(courses);
+    size_t capacity = capacityFor(courses);
+    if (mode == StorageMode::Flat)
+    {
+        records.reserve(courses);
+        if (capacity <= tableSize) return;
+        if (numElements > 0)
+        {
+            flatGrow(capacity);
+            return;
+        }
+        tableSize = capacity;
+        controls.assign(tableSize, FLAT_EMPTY);
+        slots.assign(tableSize, FlatSlot());
+        metrics().addBytes(tableSize * (sizeof(FlatSlot) + 1));
+        return;
+    }
+
+    finishRehash();
+    if (capacity <= tableSize) return;
+    if (numElements > 0)
+    {
+        reSize(capacity);
+        finishRehash();
+        return;
+    }
+    tableSize = capacity;
+    buckets.assign(tableSize, Node());
+    metrics().addBytes(tableSize * sizeof(Node));
+}
+
+/**
+ * setMaxLoadFactor
+ *
+ * Changes the growth threshold: courses per bucket for chained storage (0.25 to 8), full slots
+ * per slot for flat storage (0.25 to 0.95, probing needs empty slots). A lower one than the table
+ * is at takes effect on the next Insert.
+ * @param load the new threshold, clamped to the range of the storage.
+ */
+void CourseHashTable::setMaxLoadFactor(double load)
+{
+    double highest = baseMode == StorageMode::Flat ? 0.95 : 8.0;
+    maxLoadFactor = load >= 0.25 ? min(load, highest) : 0.25;
+}
+
+/**
+ * copyFrom
+ *
+ * Replaces this table's courses with a copy of source's, e.g. to change a published catalog
+ * aside. Ids are interned in the same order so they stay the same, nothing is parsed or
+ * validated again, and the cached views come along. The storage mode and hash settings of this
+ * table are kept.
+ *
+ * @param source table to copy, any storage mode.
+ */
+void CourseHashTable::copyFrom(const CourseHashTable& source)
+{
+    Clear();
+    reserve(source.Size());
+    courseIds.reserve(source.idCount());
+    for (size_t id = 0; id < source.idCount(); id++) courseIds.intern(source.courseNumberOf(static_cast<CourseId>(id)));
+    source.forEachCourse([&](CourseId id, const CourseId* prerequisites, size_t count)
+        {
+            storeCourse(id, source.viewById(id).name, prerequisites, count);
+        });
+    finishRehash();
+    // same ids, so the cached views still fit
+    lock_guard<mutex> guard(source.viewLock);
+    views = source.views;
+}
+
+
+/**
+ * Insert
+ *
+ * This is for loading data and inserting it into the data structure.
+ * It checks the buckets and inserts it, traverses the chain until it finds an empty one.
+ * 
+ * @param It passes the course to hash the courseNumber and insert it.
+ * @return Upon inserting the course, it returns. It increases the chain length and checks for resizing too.
+ */
+
+void CourseHashTable::Insert(const Course& course)
+{
+    ScopedTimer timer(Op::Insert);
+    thaw();
+    // the strings are copied into the arena, the course itself isn't kept
+    CourseId id = courseIds.intern(course.courseNumber);
+    views.invalidate(id);
+    scratchIds.resize(course.prerequisites.size());
+    for (size_t i = 0; i < course.prerequisites.size(); i++)
+    {
+        scratchIds[i] = courseIds.intern(course.prerequisites[i]);
+    }
+    storeCourse(id, course.name, scratchIds.data(), scratchIds.size());
+}
+
+/**
+ * insertFields
+ *
+ * Insert straight from string views, e.g. fields of a memory mapped file.
+ */
+void CourseHashTable::insertFields(string_view courseNumber, string_view name, const string_view* prerequisites, size_t count)
+{
+    thaw();
+    CourseId id = courseIds.intern(courseNumber);
+    scratchIds.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        scratchIds[i] = courseIds.intern(prerequisites[i]);
+    }
+    insertInterned(id, name, scratchIds.data(), count);
+}
+
+/**
+ * insertInterned
+ *
+ * Insert for a caller that already interned the course number and prerequisites with intern().
+ */
+void CourseHashTable::insertInterned(CourseId id, string_view name, const CourseId* prerequisites, size_t count)
+{
+    ScopedTimer timer(Op::Insert);
+    thaw();
+    views.invalidate(id);
+    storeCourse(id, name, prerequisites, count);
+}
+
+/**
+ * storeCourse
+ *
+ * The insert behind all the public ones: finds or adds the record for the id and fills it in.
+ * An existing course is updated in place, the replaced strings stay in the arena until Clear().
+ */
+void CourseHashTable::storeCourse(CourseId id, string_view name, const CourseId* prerequisites, size_t count)
+{
+    // a new course goes into the sorted index, an update keeps its place
+    bool added = !isCourse(id);
+    if (added) unsortedIds.push_back(id);
+    markDefined(id);
+    CourseRecord& record = mode == StorageMode::Flat ? flatRecordFor(id) : chainedRecordFor(id);
+    if (added)
+    {
+        titlePending.push_back(id);
+    }
+    else if (id < titleIndexed.size() && titleIndexed[id] && record.name != name)
+    {
+        // renamed after it was indexed, its old words have to go
+        titleRemovals.emplace_back(id, record.name);
+        titlePending.push_back(id);
+    }
+    fillRecord(record, name, prerequisites, count);
+}
+
+void CourseHashTable::markDefined(CourseId id)
+{
+    if (id >= definedIds.size()) definedIds.resize(max<size_t>(id + 1, definedIds.size() * 2));
+    definedIds[id] = true;
+}
+
+/**
+ * Remove
+ *
+ * Takes a course out of the table. Its course number stays interned with the same id, other
+ * courses may still name it as a prerequisite, and its strings stay in the arena until Clear().
+ * The listing and title indexes drop it on their next update.
+ *
+ * @param courseNumber of the course to remove.
+ * @return false if it isn't a loaded course.
+ */
+bool CourseHashTable::Remove(string_view courseNumber)
+{
+    ScopedTimer timer(Op::Remove);
+    CourseId id = idOf(courseNumber);
+    if (!isCourse(id)) return false;
+    thaw();
+    string_view name = viewById(id).name;
+    bool removed = mode == StorageMode::Flat ? flatRemove(id) : chainedRemove(id);
+    if (!removed) return false;
+    definedIds[id] = false;
+    views.invalidate(id);
+    removedIds.push_back(id);
+    if (id < titleIndexed.size() && titleIndexed[id]) titleRemovals.emplace_back(id, name);
+    return true;
+}
+
+/**
+ * expandPrerequisites
+ *
+ * Fills the display strings of a course copy from its prerequisite ids.
+ */
+void CourseHashTable::expandPrerequisites(Course& course) const
+{
+    course.prerequisites.clear();
+    course.prerequisites.reserve(course.prerequisiteIds.size());
+    for (CourseId prereq : course.prerequisiteIds)
+    {
+        course.prerequisites.emplace_back(courseNumberOf(prereq));
+    }
+}
+
+/**
+ * chainedRecordFor
+ *
+ * The chained Insert: finds the record for the course id, or adds a node with just the key
+ * stored. New nodes come from the pool. Ids are compared instead of strings, they're interned.
+ *
+ * @param id of the course being inserted, already interned.
+ * @return the record for the caller to fill in.
+ */
+CourseHashTable::CourseRecord& CourseHashTable::chainedRecordFor(CourseId id)
+{
+    CourseKey courseKey = courseIds.key(id);
+    if (!oldBuckets.empty())
+    {
+        // resize in progress, pay for a few old buckets
+        migrateBuckets(REHASH_STEP);
+        // the course may still sit in a bucket that hasn't moved yet, update it there
+        if (!oldBuckets.empty())
+        {
+            // non-const table, so writing through the found node is fine
+            Node* old = const_cast<Node*>(findNode(&oldBuckets[hash(courseKey, oldBuckets.size())], courseKey));
+            if (old != nullptr) return old->record;
+        }
+    }
+
+    unsigned int key = hash(courseKey);
+    // retrieve bucket location using hash key
+    Node* node = &buckets.at(key);
+
+    // if the head bucket/node is empty
+    if (node->key == UINT_MAX)
+    {
+        // First course in this bucket direct insert 
+        node->key = key;
+        node->record = CourseRecord();
+        node->record.key = courseKey;
+        node->record.id = id;
+        node->next = nullptr;
+        numElements++;
+        // check if resize is needed, the buckets vector moves to oldBuckets whole so the record stays valid
+        if (numElements > tableSize * maxLoadFactor) reSize(bucketCountFor(tableSize * 2));
+        return node->record;
+    }
+
+    // update existing course
+    if (node->record.id == id) return node->record;
+    // traverse chain
+    while (node->next != nullptr)
+    {
+        node = node->next;
+        if (node->record.id == id) return node->record;
+    }
+    // add new node at end
+    Node* added = nodes.acquire();
+    added->key = key;
+    added->record.key = courseKey;
+    added->record.id = id;
+    node->next = added;
+    numElements++;
+
+    // check if resize is needed, pool nodes don't move so the record stays valid
+    if (numElements > tableSize * maxLoadFactor) reSize(bucketCountFor(tableSize * 2));
+    return added->record;
+}
+
+/**
+ * chainedRemove
+ *
+ * Unlinks the course's node. A head bucket takes over its successor's record, so the bucket
+ * vector keeps holding the first node of every chain.
+ *
+ * @param id of the course to remove.
+ * @return false if it isn't stored.
+ */
+bool CourseHashTable::chainedRemove(CourseId id)
+{
+    // one bucket array to look in
+    finishRehash();
+    Node* node = &buckets[hash(courseIds.key(id))];
+    if (node->key == UINT_MAX) return false;
+    if (node->record.id == id)
+    {
+        Node* next = node->next;
+        if (next == nullptr)
+        {
+            *node = Node();
+        }
+        else
+        {
+            node->record = next->record;
+            node->next = next->next;
+            nodes.release(next);
+        }
+        numElements--;
+        return true;
+    }
+    for (; node->next != nullptr; node = node->next)
+    {
+        Node* next = node->next;
+        if (next->record.id != id) continue;
+        node->next = next->next;
+        nodes.release(next);
+        numElements--;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * searchCourse
+ *
+ * Searches for a specific course, along with the prerequisites.
+ * 
+ * @param courseNumber to look up.
+ * @return if found, the course, otherwise emptyCourse data, not found.
+ */
+
+Course CourseHashTable::searchCourse(const string& courseNumber) const
+{
+    ScopedTimer timer(Op::Search);
+    Course emptyCourse; // empty course data to return if not found
+
+    CourseView view = lookup(courseNumber);
+    if (!view)
+    {
+        // not found
+        return emptyCourse;
+    }
+    // found, deep copy for the caller
+    return toCourse(view);
+}
+
+/**
+ * chainedFind
+ *
+ * Chain walk for the chained storage, including the old buckets while a resize is running.
+ * @return the node holding the course, or nullptr.
+ */
+const CourseHashTable::Node* CourseHashTable::chainedFind(const CourseKey& key) const
+{
+    return chainedFind(key, hash(key));
+}
+
+// chainedFind with the bucket index already computed
+const CourseHashTable::Node* CourseHashTable::chainedFind(const CourseKey& key, unsigned int bucket, size_t* probes) const
+{
+    const Node* node = findNode(&buckets[bucket], key, probes);
+    // during a resize it may not have moved yet, migrated buckets are empty so checking is safe
+    if (node == nullptr && !oldBuckets.empty())
+    {
+        node = findNode(&oldBuckets[hash(key, oldBuckets.size())], key, probes);
+    }
+    return node;
+}
+
+/**
+ * findCourse
+ *
+ * Lookup without copying anything.
+ *
+ * @param courseNumber to look up.
+ * @return a view of the stored course, empty (false) if it's not found.
+ */
+CourseView CourseHashTable::findCourse(string_view courseNumber) const
+{
+    ScopedTimer timer(Op::Find);
+    return lookup(courseNumber);
+}
+
+/**
+ * lookup
+ *
+ * The lookup behind findCourse and searchCourse, records the probe count.
+ */
+CourseView CourseHashTable::lookup(string_view courseNumber) const
+{
+    size_t probes = 0;
+    CourseView view;
+    if (mode == StorageMode::Snapshot)
+    {
+        CourseId id = snapshotFind(courseNumber, keyHash(courseNumber), &probes);
+        if (isCourse(id)) view = snapshotView(snapRecords[snapIds[id].record]);
+    }
+    else if (mode == StorageMode::Flat)
+    {
+        CourseKey key(courseNumber);
+        const CourseRecord* record = flatFind(key, keyHash(key), &probes);
+        if (record != nullptr) view = viewOf(*record);
+    }
+    else
+    {
+        CourseKey key(courseNumber);
+        const Node* node = chainedFind(key, hash(key), &probes);
+        if (node != nullptr) view = viewOf(node->record);
+    }
+    if (metrics().on()) metrics().probes.record(probes);
+    return view;
+}
+
+/**
+ * findMany
+ *
+ * Resolves a batch of keys. Keys go in groups of FIND_BATCH: first every key is hashed and its
+ * bucket (or control byte and slot) prefetched, then the group is resolved, so the cache misses
+ * of the group overlap instead of happening one after another.
+ *
+ * @param keys to look up, count of keys, results gets one view per key (empty if not found).
+ */
+void CourseHashTable::findMany(const string_view* keys, size_t count, CourseView* results) const
+{
+    ScopedTimer timer(Op::FindMany);
+    uint64_t hashes[FIND_BATCH]; // full key hash (flat) or bucket index (chained)
+    CourseKey packed[FIND_BATCH]; // the keys of the group, packed once
+    for (size_t base = 0; base < count; base += FIND_BATCH)
+    {
+        size_t group = min(FIND_BATCH, count - base);
+        for (size_t k = 0; k < group; k++)
+        {
+            packed[k] = CourseKey(keys[base + k]);
+            if (mode == StorageMode::Snapshot)
+            {
+                hashes[k] = keyHash(packed[k]);
+                size_t home = (hashes[k] >> 7) & (tableSize - 1);
+                prefetch(&snapControls[home]);
+                prefetch(&snapSlots[home]);
+            }
+            else if (mode == StorageMode::Flat)
+            {
+                hashes[k] = keyHash(packed[k]);
+                size_t home = (hashes[k] >> 7) & (tableSize - 1);
+                prefetch(&controls[home]);
+                prefetch(&slots[home]);
+            }
+            else
+            {
+                hashes[k] = hash(packed[k]);
+                prefetch(&buckets[hashes[k]]);
+            }
+        }
+        for (size_t k = 0; k < group; k++)
+        {
+            if (mode == StorageMode::Snapshot)
+            {
+                CourseId id = snapshotFind(keys[base + k], hashes[k]);
+                results[base + k] = isCourse(id) ? snapshotView(snapRecords[snapIds[id].record]) : CourseView();
+            }
+            else if (mode == StorageMode::Flat)
+            {
+                const CourseRecord* record = flatFind(packed[k], hashes[k]);
+                results[base + k] = record != nullptr ? viewOf(*record) : CourseView();
+            }
+            else
+            {
+                const Node* node = chainedFind(packed[k], static_cast<unsigned int>(hashes[k]));
+                results[base + k] = node != nullptr ? viewOf(node->record) : CourseView();
+            }
+        }
+    }
+}
+
+/**
+ * viewOf
+ *
+ * View of a stored record. The course number comes from the interned copy rather than the
+ * record's key, an inline key's characters move with the record.
+ */
+CourseView CourseHashTable::viewOf(const CourseRecord& record) const
+{
+    CourseView view;
+    view.courseNumber = courseIds.courseNumber(record.id);
+    view.name = record.name;
+    view.prerequisiteIds = record.prerequisites;
+    view.prerequisiteCount = record.prerequisiteCount;
+    view.id = record.id;
+    return view;
+}
+
+/**
+ * printAll
+ *
+ * Prints all the courses in sorted order, from the sorted index. The text is built in one
+ * buffer and written in big pieces instead of flushing every line.
+ *
+ * @param out stream to print to, cout by default.
+ */
+
+void CourseHashTable::printAll(ostream& out) const
+{
+    ScopedTimer timer(Op::PrintAll);
+    ensureSorted();
+	// print all courses header
+    string buffer = "\nCourse List:\n============\n";
+    buffer.reserve(OUTPUT_FLUSH_BYTES + 4096);
+    // print sorted courses
+    for (CourseId id : sortedIds)
+    {
+        CourseView course = viewById(id);
+        buffer.append(course.courseNumber).append(", ").append(course.name).append("\n");
+        if (buffer.size() >= OUTPUT_FLUSH_BYTES)
+        {
+            out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+    buffer.append("\nTotal courses: ").append(to_string(sortedIds.size())).append("\n");
+    out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    out.flush();
+}
+
+/**
+ * listCourses
+ *
+ * One page of the courses whose number starts with prefix, in course number order.
+ * The matches are a contiguous range of the sorted index found by binary search, so a page
+ * costs O(log n + limit) once the index is up to date.
+ *
+ * @param prefix to match ("" for every course), offset of the first match to return,
+ * limit on the page size, page gets the courses.
+ * @return the number of courses matching prefix.
+ */
+size_t CourseHashTable::listCourses(string_view prefix, size_t offset, size_t limit, vector<CourseView>& page) const
+{
+    page.clear();
+    ensureSorted();
+    auto first = lower_bound(sortedIds.begin(), sortedIds.end(), prefix, [this](CourseId id, string_view key)
+        {
+            return courseNumberOf(id) < key;
+        });
+    auto last = partition_point(first, sortedIds.end(), [this, prefix](CourseId id)
+        {
+            return courseNumberOf(id).substr(0, prefix.size()) == prefix;
+        });
+    size_t total = static_cast<size_t>(last - first);
+    for (auto it = first + min(offset, total); it != last && page.size() < limit; ++it)
+    {
+        page.push_back(viewById(*it));
+    }
+    return total;
+}
+
+/**
+ * ensureSorted
+ *
+ * Sorts the ids added since the last listing and merges them into the sorted index.
+ * Listings are const, so the rebuild is locked in case two readers list at the same time.
+ * A snapshot's records are already in course number order, they're only copied.
+ */
+void CourseHashTable::ensureSorted() const
+{
+    lock_guard<mutex> guard(sortedLock);
+    if (mode == StorageMode::Snapshot && sortedIds.size() != numElements)
+    {
+        sortedIds.resize(numElements);
+        for (size_t r = 0; r < numElements; r++) sortedIds[r] = snapRecords[r].id;
+    }
+    if (!removedIds.empty())
+    {
+        // a removed course that came back is in unsortedIds again, so it goes from sortedIds either way
+        vector<char> removed(idCount(), false);
+        for (CourseId id : removedIds) removed[id] = true;
+        sortedIds.erase(remove_if(sortedIds.begin(), sortedIds.end(), [&](CourseId id) { return removed[id]; }), sortedIds.end());
+        unsortedIds.erase(remove_if(unsortedIds.begin(), unsortedIds.end(), [this](CourseId id) { return !isCourse(id); }), unsortedIds.end());
+        vector<CourseId>().swap(removedIds);
+    }
+    if (unsortedIds.empty()) return;
+    // sorted as packed keys, a compare is two byte swapped word compares instead of a string compare
+    vector<pair<CourseKey, CourseId>> keyed(unsortedIds.size());
+    for (size_t i = 0; i < unsortedIds.size(); i++) keyed[i] = { CourseKey(courseNumberOf(unsortedIds[i])), unsortedIds[i] };
+    sort(keyed.begin(), keyed.end(), [](const pair<CourseKey, CourseId>& a, const pair<CourseKey, CourseId>& b) { return a.first < b.first; });
+    for (size_t i = 0; i < keyed.size(); i++) unsortedIds[i] = keyed[i].second;
+    auto byNumber = [this](CourseId a, CourseId b)
+        {
+            return courseNumberOf(a) < courseNumberOf(b);
+        };
+    // added, removed and added again before a listing
+    unsortedIds.erase(unique(unsortedIds.begin(), unsortedIds.end()), unsortedIds.end());
+    size_t middle = sortedIds.size();
+    sortedIds.insert(sortedIds.end(), unsortedIds.begin(), unsortedIds.end());
+    inplace_merge(sortedIds.begin(), sortedIds.begin() + middle, sortedIds.end(), byNumber);
+    vector<CourseId>().swap(unsortedIds);
+}
+
+/**
+ * ensureTitles
+ *
+ * Applies the renames and indexes the courses added since the last search.
+ */
+void CourseHashTable::ensureTitles() const
+{
+    lock_guard<mutex> guard(titleLock);
+    // a snapshot has no title index in the file, the first search builds it
+    if (mode == StorageMode::Snapshot && titleIndexed.empty())
+    {
+        for (size_t r = 0; r < numElements; r++) titlePending.push_back(snapRecords[r].id);
+    }
+    if (titlePending.empty() && titleRemovals.empty()) return;
+    for (const pair<CourseId, string_view>& removal : titleRemovals)
+    {
+        titles.remove(removal.first, removal.second);
+        titleIndexed[removal.first] = false;
+    }
+    titleRemovals.clear();
+    // a course renamed twice is pending twice
+    sort(titlePending.begin(), titlePending.end());
+    titlePending.erase(unique(titlePending.begin(), titlePending.end()), titlePending.end());
+    if (titleIndexed.size() < idCount()) titleIndexed.resize(idCount(), false);
+    for (CourseId id : titlePending)
+    {
+        // removed again before it was indexed
+        if (titleIndexed[id] || !isCourse(id)) continue;
+        titles.add(id, viewById(id).name);
+        titleIndexed[id] = true;
+    }
+    vector<CourseId>().swap(titlePending);
+    titles.prepare();
+}
+
+/**
+ * buildIndexes
+ *
+ * Brings the sorted index and the title index up to date, e.g. right after a load so the
+ * first listing or search doesn't pay for it.
+ */
+void CourseHashTable::buildIndexes() const
+{
+    ensureSorted();
+    ensureTitles();
+}
+
+/**
+ * renderView
+ *
+ * Formats a course the way menu option 3 shows it: the course, its prerequisites and every course
+ * needed before it, found depth first over the prerequisite ids and listed by course number.
+ *
+ * @param id of a loaded course, text gets the view, chain gets the ids it was made from (id included).
+ */
+void CourseHashTable::renderView(CourseId id, string& text, vector<CourseId>& chain) const
+{
+    CourseView course = viewById(id);
+    text.clear();
+    text.append(course.courseNumber).append(", ").append(course.name).append("\n");
+    chain.assign(1, id);
+    if (course.prerequisiteCount == 0)
+    {
+        text.append("No prerequisites\n");
+        return;
+    }
+    text.append("Prerequisites: ");
+    for (size_t i = 0; i < course.prerequisiteCount; i++)
+    {
+        if (i > 0) text.append(", ");
+        text.append(courseNumberOf(course.prerequisiteIds[i]));
+    }
+    text.append("\n");
+
+    // the whole chain, a cycle can't loop since every id is only expanded once
+    unordered_set<CourseId> seen = { id };
+    vector<CourseId> stack(course.prerequisiteIds, course.prerequisiteIds + course.prerequisiteCount);
+    while (!stack.empty())
+    {
+        CourseId prereq = stack.back();
+        stack.pop_back();
+        if (!seen.insert(prereq).second) continue;
+        chain.push_back(prereq);
+        CourseView next = viewById(prereq);
+        stack.insert(stack.end(), next.prerequisiteIds, next.prerequisiteIds + next.prerequisiteCount);
+    }
+    vector<CourseId> ancestors(chain.begin() + 1, chain.end());
+    sort(ancestors.begin(), ancestors.end(), [&](CourseId a, CourseId b) { return courseNumberOf(a) < courseNumberOf(b); });
+    text.append("Prerequisite chain (").append(to_string(ancestors.size())).append("): ");
+    for (size_t i = 0; i < ancestors.size(); i++)
+    {
+        if (i > 0) text.append(", ");
+        text.append(courseNumberOf(ancestors[i]));
+    }
+    text.append("\n");
+}
+
+/**
+ * renderedView
+ *
+ * The course as renderView formats it, from the view cache when it's there. A miss renders
+ * outside the lock and caches the result, so readers only wait on each other for the copy.
+ *
+ * @param courseNumber to show, text gets the view.
+ * @return false if it isn't a loaded course.
+ */
+bool CourseHashTable::renderedView(string_view courseNumber, string& text) const
+{
+    CourseId id = idOf(courseNumber);
+    if (!isCourse(id)) return false;
+    {
+        lock_guard<mutex> guard(viewLock);
+        if (views.find(id, text)) return true;
+    }
+    vector<CourseId> chain;
+    renderView(id, text, chain);
+    lock_guard<mutex> guard(viewLock);
+    views.store(id, text, chain);
+    return true;
+}
+
+/**
+ * carryViews
+ *
+ * For a reload, which builds a new table: the previous table's cached views are kept if every
+ * course in their chain is loaded in this table with the same name and prerequisites, the rest
+ * count as invalidated. Ids are mapped by course number, the two tables intern independently.
+ *
+ * @param previous table, e.g. the catalog this one replaces.
+ */
+void CourseHashTable::carryViews(const CourseHashTable& previous)
+{
+    if (&previous == this) return;
+    // the course number means the same course in both tables
+    auto unchanged = [&](CourseId before, CourseId& after)
+        {
+            after = idOf(previous.courseNumberOf(before));
+            if (after == INVALID_COURSE_ID || isCourse(after) != previous.isCourse(before)) return false;
+            if (!isCourse(after)) return true;
+            CourseView old = previous.viewById(before), now = viewById(after);
+            if (old.name != now.name || old.prerequisiteCount != now.prerequisiteCount) return false;
+            for (size_t i = 0; i < old.prerequisiteCount; i++)
+            {
+                if (previous.courseNumberOf(old.prerequisiteIds[i]) != courseNumberOf(now.prerequisiteIds[i])) return false;
+            }
+            return true;
+        };
+
+    lock_guard<mutex> guard(previous.viewLock);
+    views.setCapacity(previous.views.statistics().capacity);
+    uint64_t dropped = 0;
+    vector<CourseId> chain;
+    previous.views.forEach([&](CourseId, string_view rendered, const vector<CourseId>& oldChain)
+        {
+            chain.resize(oldChain.size());
+            for (size_t i = 0; i < oldChain.size(); i++)
+            {
+                if (!unchanged(oldChain[i], chain[i]))
+                {
+                    dropped++;
+                    return;
+                }
+            }
+            // the chain starts with the course itself
+            views.store(chain[0], rendered, chain);
+        });
+    views.carryCounters(previous.views, dropped);
+}
+
+// views kept, 0 turns the cache off, the cached ones are dropped
+void CourseHashTable::setViewCacheCapacity(size_t entries)
+{
+    lock_guard<mutex> guard(viewLock);
+    views.setCapacity(entries);
+}
+
+ViewCacheStats CourseHashTable::viewCacheStatistics() const
+{
+    lock_guard<mutex> guard(viewLock);
+    return views.statistics();
+}
+
+/**
+ * searchCourses
+ *
+ * Free text search. Course numbers starting with the query (spaces dropped, upper cased) rank
+ * first. Then titles: every word of the query has to match a word of the name, exactly, as a
+ * prefix or with a typo, and the score is the average match quality. The candidates come from
+ * the query word with the shortest posting lists, merged in id order, and are checked against the
+ * others by binary search. Ties keep the course with the lower id (loaded first), which lets the
+ * scan stop as soon as the top results have the best score possible for the query.
+ *
+ * @param query text, limit on results, hits gets the results best first.
+ */
+void CourseHashTable::searchCourses(string_view query, size_t limit, vector<SearchHit>& hits) const
+{
+    hits.clear();
+    if (limit == 0) return;
+    ensureSorted();
+    ensureTitles();
+
+    // course numbers
+    string number;
+    for (char c : query)
+    {
+        if (!isspace(static_cast<unsigned char>(c))) number += static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    }
+    if (!number.empty())
+    {
+        vector<CourseView> page;
+        listCourses(number, 0, limit, page);
+        for (const CourseView& course : page) hits.push_back({ course, course.courseNumber == number ? 3.0 : 2.0 });
+    }
+
+    // title words, all of them have to match
+    vector<string> words;
+    TitleIndex::tokenize(query, words);
+    if (words.empty() || hits.size() >= limit) return;
+    vector<vector<TitleIndex::Variant>> matches(words.size());
+    size_t rarest = 0;
+    size_t rarestSize = SIZE_MAX;
+    for (size_t w = 0; w < words.size(); w++)
+    {
+        titles.variants(words[w], matches[w]);
+        size_t size = 0;
+        for (const TitleIndex::Variant& variant : matches[w]) size += titles.postings(variant.word).size();
+        if (size == 0) return;
+        if (size < rarestSize)
+        {
+            rarest = w;
+            rarestSize = size;
+        }
+    }
+
+    // the best score any course could get, the scan stops once the top results all have it
+    double bestPossible = 0.0;
+    for (const vector<TitleIndex::Variant>& match : matches)
+    {
+        float best = 0.0f;
+        for (const TitleIndex::Variant& variant : match) best = max(best, variant.quality);
+        bestPossible += best;
+    }
+    bestPossible = bestPossible / words.size() - 1e-9;
+
+    // candidates are the rarest word's posting lists merged in id order, a cursor per variant
+    const vector<TitleIndex::Variant>& rarestMatches = matches[rarest];
+    vector<size_t> cursors(rarestMatches.size(), 0);
+
+    // top results as a heap with the worst on top: lower score, then higher id
+    size_t wanted = limit - hits.size();
+    vector<pair<double, CourseId>> top;
+    auto better = [](const pair<double, CourseId>& a, const pair<double, CourseId>& b)
+        {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        };
+    while (true)
+    {
+        // later ids lose ties, so nothing after this can get in
+        if (top.size() == wanted && top.front().first >= bestPossible) break;
+
+        // next id of the merge and the best quality it has for the rarest word
+        CourseId id = INVALID_COURSE_ID;
+        float quality = 0.0f;
+        for (size_t v = 0; v < rarestMatches.size(); v++)
+        {
+            const vector<CourseId>& list = titles.postings(rarestMatches[v].word);
+            if (cursors[v] < list.size() && list[cursors[v]] < id) id = list[cursors[v]];
+        }
+        if (id == INVALID_COURSE_ID) break;
+        for (size_t v = 0; v < rarestMatches.size(); v++)
+        {
+            const vector<CourseId>& list = titles.postings(rarestMatches[v].word);
+            if (cursors[v] < list.size() && list[cursors[v]] == id)
+            {
+                quality = max(quality, rarestMatches[v].quality);
+                cursors[v]++;
+            }
+        }
+
+        double score = quality;
+        for (size_t w = 0; w < words.size() && score > 0; w++)
+        {
+            if (w == rarest) continue;
+            float best = 0.0f;
+            for (const TitleIndex::Variant& variant : matches[w])
+            {
+                if (variant.quality <= best) continue;
+                const vector<CourseId>& list = titles.postings(variant.word);
+                if (binary_search(list.begin(), list.end(), id)) best = variant.quality;
+            }
+            score = best > 0 ? score + best : 0;
+        }
+        if (score <= 0) continue;
+        pair<double, CourseId> entry(score / words.size(), id);
+        if (top.size() < wanted)
+        {
+            top.push_back(entry);
+            push_heap(top.begin(), top.end(), better);
+        }
+        else if (better(entry, top.front()))
+        {
+            pop_heap(top.begin(), top.end(), better);
+            top.back() = entry;
+            push_heap(top.begin(), top.end(), better);
+        }
+    }
+    sort_heap(top.begin(), top.end(), better);
+
+    for (const pair<double, CourseId>& entry : top)
+    {
+        // already listed by its course number
+        bool listed = false;
+        for (const SearchHit& hit : hits) listed = listed || hit.course.id == entry.second;
+        if (!listed) hits.push_back({ viewById(entry.second), entry.first });
+    }
+}
+
+/**
+ * viewById
+ *
+ * View of a stored course by id, without the lookup statistics.
+ */
+CourseView CourseHashTable::viewById(CourseId id) const
+{
+    if (mode == StorageMode::Snapshot)
+    {
+        return isCourse(id) ? snapshotView(snapRecords[snapIds[id].record]) : CourseView();
+    }
+    CourseKey key = courseIds.key(id);
+    if (mode == StorageMode::Flat)
+    {
+        const CourseRecord* record = flatFind(key);
+        return record != nullptr ? viewOf(*record) : CourseView();
+    }
+    const Node* node = chainedFind(key);
+    return node != nullptr ? viewOf(node->record) : CourseView();
+}
+
+/**
+ * chainLengths
+ *
+ * Chained: counts[n] is the number of buckets holding a chain of n courses (n = 0 is empty buckets).
+ * Flat: counts[n] is the number of courses sitting n slots past their home slot.
+ * Old buckets of a running resize are counted too.
+ */
+vector<size_t> CourseHashTable::chainLengths() const
+{
+    vector<size_t> counts(1, 0);
+    auto add = [&](size_t length)
+        {
+            if (length >= counts.size()) counts.resize(length + 1, 0);
+            counts[length]++;
+        };
+    if (mode == StorageMode::Flat)
+    {
+        size_t mask = tableSize - 1;
+        for (size_t i = 0; i < tableSize; i++)
+        {
+            if (controls[i] == FLAT_EMPTY) continue;
+            size_t home = (keyHash(records[slots[i].record].key) >> 7) & mask;
+            add((i - home) & mask);
+        }
+        return counts;
+    }
+    if (mode == StorageMode::Snapshot)
+    {
+        // the snapshot index holds every id, prerequisite only ones included
+        size_t mask = tableSize - 1;
+        for (size_t i = 0; i < tableSize; i++)
+        {
+            if (snapControls[i] == FLAT_EMPTY) continue;
+            size_t home = (keyHash(courseNumberOf(snapSlots[i].record)) >> 7) & mask;
+            add((i - home) & mask);
+        }
+        return counts;
+    }
+    for (const vector<Node>* table : { &buckets, &oldBuckets })
+    {
+        for (const Node& bucket : *table)
+        {
+            size_t length = 0;
+            if (bucket.key != UINT_MAX)
+            {
+                for (const Node* node = &bucket; node != nullptr; node = node->next) length++;
+            }
+            add(length);
+        }
+    }
+    return counts;
+}
+
+/**
+ * hashStatistics
+ *
+ * Chained: a key's home is its bucket, a hit compares every key up to it in the chain.
+ * Flat and snapshot: a key's home is the slot its hash picks, a hit reads the slots from there
+ * to the key's slot. Old buckets of a running resize are left out.
+ */
+HashStats CourseHashTable::hashStatistics() const
+{
+    HashStats stats;
+    stats.buckets = tableSize;
+    size_t probes = 0;
+    if (mode == StorageMode::Chained)
+    {
+        for (const Node& bucket : buckets)
+        {
+            if (bucket.key == UINT_MAX) continue;
+            stats.homes++;
+            size_t length = 0;
+            for (const Node* node = &bucket; node != nullptr; node = node->next) probes += ++length;
+            stats.keys += length;
+            stats.longest = max(stats.longest, length);
+        }
+    }
+    else
+    {
+        const uint8_t* control = mode == StorageMode::Snapshot ? snapControls : controls.data();
+        vector<bool> home(tableSize, false);
+        size_t mask = tableSize - 1;
+        for (size_t i = 0; i < tableSize; i++)
+        {
+            if (control[i] == FLAT_EMPTY) continue;
+            uint64_t h = mode == StorageMode::Snapshot ? keyHash(courseNumberOf(snapSlots[i].record)) : keyHash(records[slots[i].record].key);
+            size_t start = (h >> 7) & mask;
+            size_t distance = ((i - start) & mask) + 1;
+            if (!home[start]) stats.homes++;
+            home[start] = true;
+            stats.keys++;
+            probes += distance;
+            stats.longest = max(stats.longest, distance);
+        }
+    }
+    stats.collisions = stats.keys - stats.homes;
+    if (stats.buckets > 0)
+    {
+        // keys minus the buckets a random hash is expected to hit
+        double b = static_cast<double>(stats.buckets);
+        stats.randomCollisions = stats.keys - b * (1.0 - pow(1.0 - 1.0 / b, static_cast<double>(stats.keys)));
+    }
+    stats.meanProbes = stats.keys > 0 ? static_cast<double>(probes) / stats.keys : 0.0;
+    return stats;
+}
+
+/**
+ * Clear
+ *
+ * Used to clear all data.
+ */
+
+void CourseHashTable::Clear()
+{
+    ScopedTimer timer(Op::Clear);
+    clearIndexes();
+    views.clear();
+    courseIds.Clear();
+    definedIds.clear();
+    // every string and prerequisite array goes at once, the blocks stay for the next load
+    arena.Reset();
+    if (mode == StorageMode::Snapshot)
+    {
+        // the base storage was emptied when the snapshot was loaded
+        snapshotFile.close();
+        mode = baseMode;
+        tableSize = mode == StorageMode::Flat ? controls.size() : buckets.size();
+        numElements = 0;
+        return;
+    }
+    if (mode == StorageMode::Flat)
+    {
+        flatClear();
+        return;
+    }
+
+    // the same for the nodes, only the bucket heads are written
+    nodes.Reset();
+    fill(buckets.begin(), buckets.end(), Node());
+    // drop a resize that was still running
+    vector<Node>().swap(oldBuckets);
+    migrateIndex = 0;
+    numElements = 0;
+}
+
+/**
+ * clearIndexes
+ *
+ * Drops the sorted and title indexes, they're rebuilt from the storage on the next use.
+ */
+void CourseHashTable::clearIndexes()
+{
+    sortedIds.clear();
+    unsortedIds.clear();
+    removedIds.clear();
+    titles.Clear();
+    titlePending.clear();
+    titleRemovals.clear();
+    titleIndexed.clear();
+}
+
+/**
+ * memoryBytes
+ *
+ * Bytes held by the table: bucket or slot arrays, records, node slabs, arena blocks, the
+ * id table and a mapped snapshot. Reserved memory counts, so it stays the same over a Clear and reload.
+ */
+size_t CourseHashTable::memoryBytes() const
+{
+    return sizeof(*this) + (buckets.capacity() + oldBuckets.capacity()) * sizeof(Node) + nodes.bytesReserved()
+        + controls.capacity() + slots.capacity() * sizeof(FlatSlot) + records.capacity() * sizeof(CourseRecord)
+        + arena.bytesReserved() + (scratchIds.capacity() + sortedIds.capacity() + unsortedIds.capacity()) * sizeof(CourseId)
+        + definedIds.capacity() / 8 + titles.memoryBytes() + titlePending.capacity() * sizeof(CourseId) + titleIndexed.capacity()
+        + courseIds.memoryBytes() + snapshotFile.view().size() + views.memoryBytes();
+}
+
+
+//============================================================================
+// Flat (open addressing) storage
+//============================================================================
+
+/**
+ * fillRecord
+ *
+ * Copies the name and prerequisite ids into the arena once.
+ *
+ * @param record to fill, name and prerequisite ids to store.
+ */
+void CourseHashTable::fillRecord(CourseRecord& record, string_view name, const CourseId* prerequisites, size_t count)
+{
+    record.name = arena.store(name);
+    record.prerequisiteCount = static_cast<uint32_t>(count);
+    record.prerequisites = nullptr;
+    if (count > 0)
+    {
+        CourseId* prereqs = static_cast<CourseId*>(arena.allocate(sizeof(CourseId) * count, alignof(CourseId)));
+        memcpy(prereqs, prerequisites, sizeof(CourseId) * count);
+        record.prerequisites = prereqs;
+    }
+}
+
+/**
+ * toCourse
+ *
+ * Builds a Course from a view of a stored one, used by searchCourse which returns by value.
+ */
+Course CourseHashTable::toCourse(const CourseView& view) const
+{
+    Course course;
+    course.courseNumber = string(view.courseNumber);
+    course.name = string(view.name);
+    course.id = view.id;
+    course.prerequisiteIds.assign(view.prerequisiteIds, view.prerequisiteIds + view.prerequisiteCount);
+    expandPrerequisites(course);
+    return course;
+}
+
+/**
+ * flatFind
+ *
+ * Linear probing from the home slot. The control byte tag and the stored upper hash bits
+ * reject almost every other key before touching the record. The load factor is kept
+ * below 7/8, so an empty slot always ends the probe.
+ *
+ * @param key to look up.
+ * @return the record, or nullptr if it's not found.
+ */
+const CourseHashTable::CourseRecord* CourseHashTable::flatFind(const CourseKey& key) const
+{
+    return flatFind(key, keyHash(key));
+}
+
+// flatFind with the key hash already computed
+const CourseHashTable::CourseRecord* CourseHashTable::flatFind(const CourseKey& key, uint64_t h, size_t* probes) const
+{
+    uint8_t tag = static_cast<uint8_t>(h & 0x7F);
+    uint32_t check = static_cast<uint32_t>(h >> 32);
+    size_t mask = tableSize - 1;
+
+    for (size_t i = (h >> 7) & mask; ; i = (i + 1) & mask)
+    {
+        if (probes != nullptr) (*probes)++;
+        uint8_t control = controls[i];
+        if (control == FLAT_EMPTY) return nullptr;
+        if (control == tag && slots[i].hash == check)
+        {
+            const CourseRecord& record = records[slots[i].record];
+            if (record.key == key) return &record;
+        }
+    }
+}
+
+/**
+ * flatRecordFor
+ *
+ * Finds the record for the course id, or adds a new one with just the key stored.
+ * Same behavior as the chained Insert: an existing course is updated in place,
+ * the replaced strings stay in the arena until Clear().
+ *
+ * @param id of the course being inserted, already interned.
+ * @return the record for the caller to fill in.
+ */
+CourseHashTable::CourseRecord& CourseHashTable::flatRecordFor(CourseId id)
+{
+    CourseKey key = courseIds.key(id);
+    uint64_t h = keyHash(key);
+    uint8_t tag = static_cast<uint8_t>(h & 0x7F);
+    uint32_t check = static_cast<uint32_t>(h >> 32);
+    size_t mask = tableSize - 1;
+
+    size_t i = (h >> 7) & mask;
+    for (; controls[i] != FLAT_EMPTY; i = (i + 1) & mask)
+    {
+        if (controls[i] == tag && slots[i].hash == check
+            && records[slots[i].record].id == id)
+        {
+            // update existing course
+            return records[slots[i].record];
+        }
+    }
+
+    // new course, grow first if it would push the load factor over maxLoadFactor
+    if (numElements + 1 > tableSize * maxLoadFactor)
+    {
+        flatGrow(tableSize * 2);
+        mask = tableSize - 1;
+        for (i = (h >> 7) & mask; controls[i] != FLAT_EMPTY; i = (i + 1) & mask) {}
+    }
+    controls[i] = tag;
+    slots[i].hash = check;
+    slots[i].record = static_cast<uint32_t>(records.size());
+    records.emplace_back();
+    records.back().key = key;
+    records.back().id = id;
+    numElements++;
+    return records.back();
+}
+
+/**
+ * flatRemove
+ *
+ * Backward shift deletion, no tombstones: the slots after the removed one move back while that
+ * brings them closer to their home slot, so every probe still ends at the first empty slot.
+ * The last record then moves into the removed record's place to keep records dense.
+ *
+ * @param id of the course to remove.
+ * @return false if it isn't stored.
+ */
+bool CourseHashTable::flatRemove(CourseId id)
+{
+    const CourseRecord* found = flatFind(courseIds.key(id));
+    if (found == nullptr) return false;
+    size_t record = static_cast<size_t>(found - records.data());
+    size_t mask = tableSize - 1;
+    size_t hole = flatSlotOf(record);
+    for (size_t i = (hole + 1) & mask; controls[i] != FLAT_EMPTY; i = (i + 1) & mask)
+    {
+        size_t home = (keyHash(records[slots[i].record].key) >> 7) & mask;
+        // the slot can move back unless its home lies after the hole
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            controls[hole] = controls[i];
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    controls[hole] = FLAT_EMPTY;
+
+    size_t last = records.size() - 1;
+    if (record != last)
+    {
+        slots[flatSlotOf(last)].record = static_cast<uint32_t>(record);
+        records[record] = records[last];
+    }
+    records.pop_back();
+    numElements--;
+    return true;
+}
+
+/**
+ * flatSlotOf
+ *
+ * @param record index of a stored record.
+ * @return the slot that points at it.
+ */
+size_t CourseHashTable::flatSlotOf(size_t record) const
+{
+    size_t mask = tableSize - 1;
+    size_t i = (keyHash(records[record].key) >> 7) & mask;
+    while (controls[i] == FLAT_EMPTY || slots[i].record != record) i = (i + 1) & mask;
+    return i;
+}
+
+/**
+ * flatGrow
+ *
+ * Grows the slot array to newSize (a power of two) and re-places the records. Only the slot
+ * arrays are rebuilt, the records and their strings don't move. Walking records in insertion
+ * order keeps the key reads sequential, short keys are inline in the records.
+ */
+void CourseHashTable::flatGrow(size_t newSize)
+{
+    ScopedTimer timer(Op::ReSize);
+    metrics().resizes++;
+    metrics().rehashedBytes += records.size() * (sizeof(FlatSlot) + 1);
+    cout << "Resizing flat table from " << tableSize << " to " << newSize << " slots.\n";
+    tableSize = newSize;
+    controls.assign(tableSize, FLAT_EMPTY);
+    slots.assign(tableSize, FlatSlot());
+    metrics().addBytes(tableSize * (sizeof(FlatSlot) + 1));
+
+    size_t mask = tableSize - 1;
+    for (size_t r = 0; r < records.size(); r++)
+    {
+        uint64_t h = keyHash(records[r].key);
+        size_t i = (h >> 7) & mask;
+        while (controls[i] != FLAT_EMPTY) i = (i + 1) & mask;
+        controls[i] = static_cast<uint8_t>(h & 0x7F);
+        slots[i].hash = static_cast<uint32_t>(h >> 32);
+        slots[i].record = static_cast<uint32_t>(r);
+    }
+}
+
+/**
+ * flatClear
+ *
+ * Empties the flat storage but keeps the slot arrays for the next load.
+ */
+void CourseHashTable::flatClear()
+{
+    fill(controls.begin(), controls.end(), FLAT_EMPTY);
+    records.clear();
+    numElements = 0;
+}
+
+//============================================================================
+// Snapshot storage
+//============================================================================
+
+/**
+ * snapshotFind
+ *
+ * Same probing as flatFind, over the mapped index. Its slots hold ids instead of record indexes,
+ * so prerequisite only course numbers are found too (idOf needs them).
+ *
+ * @param courseNumber to look up, h its keyHash.
+ * @return the id, or INVALID_COURSE_ID if the snapshot doesn't know the course number.
+ */
+CourseId CourseHashTable::snapshotFind(string_view courseNumber, uint64_t h, size_t* probes) const
+{
+    uint8_t tag = static_cast<uint8_t>(h & 0x7F);
+    uint32_t check = static_cast<uint32_t>(h >> 32);
+    size_t mask = tableSize - 1;
+
+    for (size_t i = (h >> 7) & mask; ; i = (i + 1) & mask)
+    {
+        if (probes != nullptr) (*probes)++;
+        uint8_t control = snapControls[i];
+        if (control == FLAT_EMPTY) return INVALID_COURSE_ID;
+        if (control == tag && snapSlots[i].hash == check)
+        {
+            CourseId id = snapSlots[i].record;
+            if (courseNumberOf(id) == courseNumber) return id;
+        }
+    }
+}
+
+/**
+ * snapshotView
+ *
+ * View of a mapped record, it points into the file.
+ */
+CourseView CourseHashTable::snapshotView(const SnapshotRecord& record) const
+{
+    CourseView view;
+    view.courseNumber = courseNumberOf(record.id);
+    view.name = string_view(snapStrings + record.nameOffset, record.nameLength);
+    view.prerequisiteIds = snapPrereqs + record.firstPrereq;
+    view.prerequisiteCount = record.prereqCount;
+    view.id = record.id;
+    return view;
+}
+
+/**
+ * thawSnapshot
+ *
+ * The mapping is read only, so the first change copies the catalog into baseMode storage and
+ * unmaps the file. Ids are interned in the same order, so every id stays the same.
+ */
+void CourseHashTable::thawSnapshot()
+{
+    // the indexes may hold names from the mapping
+    clearIndexes();
+    size_t courses = numElements;
+    mode = baseMode;
+    numElements = 0;
+    tableSize = mode == StorageMode::Flat ? controls.size() : buckets.size();
+    // sized up front so the copy doesn't resize on the way
+    reserve(courses);
+
+    courseIds.reserve(snapIdCount);
+    for (size_t id = 0; id < snapIdCount; id++)
+    {
+        courseIds.intern(string_view(snapStrings + snapIds[id].offset, snapIds[id].length));
+    }
+    for (size_t r = 0; r < courses; r++)
+    {
+        const SnapshotRecord& record = snapRecords[r];
+        storeCourse(record.id, string_view(snapStrings + record.nameOffset, record.nameLength),
+            snapPrereqs + record.firstPrereq, record.prereqCount);
+    }
+    snapshotFile.close();
+    snapIdCount = 0;
+}
+
+/**
+ * saveSnapshot
+ *
+ * Writes the catalog in the snapshot layout (see SnapshotHeader): every interned course number,
+ * the records in course number order, their prerequisite ids and a prebuilt hash index at a
+ * load factor of at most 1/2. It's written next to path and renamed over it, so a snapshot that's
+ * currently mapped isn't overwritten under the reader.
+ *
+ * @param path of the snapshot file.
+ * @return false with a message if it can't be written.
+ */
+bool CourseHashTable::saveSnapshot(const string& path) const
+{
+    ScopedTimer timer(Op::SnapshotSave);
+    ensureSorted();
+    size_t ids = idCount();
+
+    string strings;
+    vector<SnapshotId> idEntries(ids);
+    vector<SnapshotRecord> recordEntries(sortedIds.size());
+    vector<CourseId> prereqs;
+    for (size_t id = 0; id < ids; id++)
+    {
+        string_view number = courseNumberOf(static_cast<CourseId>(id));
+        idEntries[id] = { static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(number.size()), UINT32_MAX };
+        strings.append(number);
+    }
+    for (size_t r = 0; r < sortedIds.size(); r++)
+    {
+        CourseView course = viewById(sortedIds[r]);
+        SnapshotRecord& record = recordEntries[r];
+        record.nameOffset = static_cast<uint32_t>(strings.size());
+        record.nameLength = static_cast<uint32_t>(course.name.size());
+        record.firstPrereq = static_cast<uint32_t>(prereqs.size());
+        record.prereqCount = static_cast<uint32_t>(course.prerequisiteCount);
+        record.id = course.id;
+        record.reserved = 0;
+        idEntries[course.id].record = static_cast<uint32_t>(r);
+        strings.append(course.name);
+        prereqs.insert(prereqs.end(), course.prerequisiteIds, course.prerequisiteIds + course.prerequisiteCount);
+    }
+    // offsets in the file are 32 bit
+    if (strings.size() > UINT32_MAX || prereqs.size() > UINT32_MAX)
+    {
+        cout << "Error: catalog is too big for a snapshot." << endl;
+        return false;
+    }
+
+    size_t slotCount = FLAT_DEFAULT_CAPACITY;
+    while (ids * 2 > slotCount) slotCount *= 2;
+    vector<uint8_t> indexControls(slotCount, FLAT_EMPTY);
+    vector<FlatSlot> indexSlots(slotCount);
+    for (size_t id = 0; id < ids; id++)
+    {
+        uint64_t h = keyHash(courseNumberOf(static_cast<CourseId>(id)));
+        size_t i = (h >> 7) & (slotCount - 1);
+        while (indexControls[i] != FLAT_EMPTY) i = (i + 1) & (slotCount - 1);
+        indexControls[i] = static_cast<uint8_t>(h & 0x7F);
+        indexSlots[i].hash = static_cast<uint32_t>(h >> 32);
+        indexSlots[i].record = static_cast<uint32_t>(id);
+    }
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.endianTag = 0x01020304;
+    header.courseCount = recordEntries.size();
+    header.idCount = ids;
+    header.slotCount = slotCount;
+    header.prereqCount = prereqs.size();
+    header.stringBytes = strings.size();
+    header.hashSeed = Seed();
+    // sections follow each other, each padded to 8 bytes
+    uint64_t offset = sizeof(SnapshotHeader);
+    auto place = [&offset](size_t bytes)
+        {
+            uint64_t start = offset;
+            offset += (bytes + 7) & ~size_t(7);
+            return start;
+        };
+    header.stringsOffset = place(strings.size());
+    header.idsOffset = place(idEntries.size() * sizeof(SnapshotId));
+    header.recordsOffset = place(recordEntries.size() * sizeof(SnapshotRecord));
+    header.prereqsOffset = place(prereqs.size() * sizeof(CourseId));
+    header.controlsOffset = place(indexControls.size());
+    header.slotsOffset = place(indexSlots.size() * sizeof(FlatSlot));
+    header.fileBytes = offset;
+
+    string tempPath = path + ".tmp";
+    ofstream out(tempPath, ios::binary | ios::trunc);
+    if (!out.is_open())
+    {
+        cout << "Error: Could not open file " << tempPath << endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    auto section = [&](const void* data, size_t bytes)
+        {
+            out.write(static_cast<const char*>(data), static_cast<streamsize>(bytes));
+            char padding[8] = {};
+            out.write(padding, static_cast<streamsize>(((bytes + 7) & ~size_t(7)) - bytes));
+        };
+    section(strings.data(), strings.size());
+    section(idEntries.data(), idEntries.size() * sizeof(SnapshotId));
+    section(recordEntries.data(), recordEntries.size() * sizeof(SnapshotRecord));
+    section(prereqs.data(), prereqs.size() * sizeof(CourseId));
+    section(indexControls.data(), indexControls.size());
+    section(indexSlots.data(), indexSlots.size() * sizeof(FlatSlot));
+
+    out.close();
+
+    // the body is checksummed the way loadSnapshot does it, from the written file,
+    // then the header goes in again with the checksums
+    bool written = static_cast<bool>(out);
+    if (written)
+    {
+        MappedFile file;
+        written = file.open(tempPath) && file.view().size() == header.fileBytes;
+        if (written) header.bodyChecksum = snapshotBodyChecksum(file.view().substr(sizeof(header)));
+    }
+    if (written)
+    {
+        SnapshotChecksum headerSum;
+        headerSum.add(&header, sizeof(header));
+        header.headerChecksum = headerSum.value();
+        fstream patch(tempPath, ios::in | ios::out | ios::binary);
+        patch.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        written = static_cast<bool>(patch);
+    }
+    if (!written)
+    {
+        cout << "Error: Could not write " << tempPath << endl;
+        remove(tempPath.c_str());
+        return false;
+    }
+    // rename doesn't replace an existing file everywhere
+    if (rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        remove(path.c_str());
+        if (rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            cout << "Error: Could not replace " << path << endl;
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * loadSnapshot
+ *
+ * Maps a snapshot file and switches the table to it. The header is checked (magic, version, byte
+ * order, header checksum, section bounds), then one pass over the ids, records, prerequisites and
+ * index checks that everything they point at is inside its section, no hashing or string reads.
+ * With verify the body checksum is checked too, which reads the whole file.
+ * Lookups then go straight to the mapped index and records, the listing and title indexes are
+ * built on first use, and the first change copies everything into the table's own storage.
+ *
+ * @param path of the snapshot file, verify to check the body checksum.
+ * @return false with a message if it isn't a usable snapshot, the table is empty then.
+ */
+bool CourseHashTable::loadSnapshot(const string& path, bool verify)
+{
+    static_assert(sizeof(SnapshotHeader) % 8 == 0, "snapshot sections have to stay 8 byte aligned");
+    ScopedTimer timer(Op::SnapshotLoad);
+    Clear();
+    if (!snapshotFile.open(path, true))
+    {
+        cout << "Error: Could not open file " << path << endl;
+        return false;
+    }
+    string_view data = snapshotFile.view();
+    auto reject = [&](const char* reason)
+        {
+            cout << "Error: " << path << " is not a usable snapshot, " << reason << "." << endl;
+            snapshotFile.close();
+            return false;
+        };
+    if (data.size() < sizeof(SnapshotHeader)) return reject("it's too short");
+    SnapshotHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) return reject("wrong file type");
+    if (header.endianTag != 0x01020304) return reject("it was written with a different byte order");
+    if (header.version != SNAPSHOT_VERSION) return reject("unsupported version");
+    uint64_t stored = header.headerChecksum;
+    header.headerChecksum = 0;
+    SnapshotChecksum headerSum;
+    headerSum.add(&header, sizeof(header));
+    if (headerSum.value() != stored) return reject("header checksum mismatch");
+    if (header.fileBytes != data.size()) return reject("the file size doesn't match, it's truncated");
+
+    // every section has to be aligned and inside the file
+    auto fits = [&](uint64_t offset, uint64_t count, size_t size)
+        {
+            return offset % 8 == 0 && offset >= sizeof(SnapshotHeader) && offset <= header.fileBytes
+                && count <= (header.fileBytes - offset) / size;
+        };
+    if (!fits(header.stringsOffset, header.stringBytes, 1) || !fits(header.idsOffset, header.idCount, sizeof(SnapshotId))
+        || !fits(header.recordsOffset, header.courseCount, sizeof(SnapshotRecord))
+        || !fits(header.prereqsOffset, header.prereqCount, sizeof(CourseId))
+        || !fits(header.controlsOffset, header.slotCount, 1) || !fits(header.slotsOffset, header.slotCount, sizeof(FlatSlot))
+        || header.courseCount > header.idCount || header.idCount >= header.slotCount
+        || (header.slotCount & (header.slotCount - 1)) != 0)
+    {
+        return reject("bad section table");
+    }
+    if (verify && snapshotBodyChecksum(data.substr(sizeof(header))) != header.bodyChecksum)
+    {
+        return reject("checksum mismatch, the file is damaged");
+    }
+
+    // every string, prerequisite and id a record, id or slot points at has to be inside its section,
+    // the checksum alone doesn't cover --no-verify or a file written to look valid
+    const SnapshotId* mappedIds = reinterpret_cast<const SnapshotId*>(data.data() + header.idsOffset);
+    const SnapshotRecord* mappedRecords = reinterpret_cast<const SnapshotRecord*>(data.data() + header.recordsOffset);
+    const CourseId* mappedPrereqs = reinterpret_cast<const CourseId*>(data.data() + header.prereqsOffset);
+    const uint8_t* mappedControls = reinterpret_cast<const uint8_t*>(data.data() + header.controlsOffset);
+    const FlatSlot* mappedSlots = reinterpret_cast<const FlatSlot*>(data.data() + header.slotsOffset);
+    auto inside = [](uint64_t offset, uint64_t length, uint64_t size) { return offset <= size && length <= size - offset; };
+    for (uint64_t id = 0; id < header.idCount; id++)
+    {
+        const SnapshotId& entry = mappedIds[id];
+        if (!inside(entry.offset, entry.length, header.stringBytes)
+            || (entry.record != UINT32_MAX && (entry.record >= header.courseCount || mappedRecords[entry.record].id != id)))
+        {
+            return reject("bad course number entry");
+        }
+    }
+    for (uint64_t r = 0; r < header.courseCount; r++)
+    {
+        const SnapshotRecord& record = mappedRecords[r];
+        if (!inside(record.nameOffset, record.nameLength, header.stringBytes) || !inside(record.firstPrereq, record.prereqCount, header.prereqCount)
+            || record.id >= header.idCount || mappedIds[record.id].record != r)
+        {
+            return reject("bad course record");
+        }
+    }
+    for (uint64_t p = 0; p < header.prereqCount; p++)
+    {
+        if (mappedPrereqs[p] >= header.idCount) return reject("bad prerequisite id");
+    }
+    // lookups stop at the first empty slot, so there has to be one
+    uint64_t used = 0;
+    for (uint64_t i = 0; i < header.slotCount; i++)
+    {
+        if (mappedControls[i] == FLAT_EMPTY) continue;
+        if (mappedSlots[i].record >= header.idCount) return reject("bad index slot");
+        used++;
+    }
+    if (used > header.idCount) return reject("bad index");
+
+    snapStrings = data.data() + header.stringsOffset;
+    snapIds = reinterpret_cast<const SnapshotId*>(data.data() + header.idsOffset);
+    snapRecords = reinterpret_cast<const SnapshotRecord*>(data.data() + header.recordsOffset);
+    snapPrereqs = reinterpret_cast<const CourseId*>(data.data() + header.prereqsOffset);
+    snapControls = reinterpret_cast<const uint8_t*>(data.data() + header.controlsOffset);
+    snapSlots = reinterpret_cast<const FlatSlot*>(data.data() + header.slotsOffset);
+    snapIdCount = static_cast<size_t>(header.idCount);
+    snapSeed = header.hashSeed;
+    numElements = static_cast<size_t>(header.courseCount);
+    tableSize = static_cast<size_t>(header.slotCount);
+    mode = StorageMode::Snapshot;
+    return true;
+}
+
+//============================================================================
+// Sharded table
+//============================================================================
+
+/**
+ * ShardedCourseTable
+ *
+ * CourseHashTables side by side, each course number lives in the shard picked by the top bits of
+ * its hashKey64. Every shard has its own lock, id table, arena and resizing, so threads inserting
+ * into different shards never touch the same memory. The public calls lock the one shard they
+ * need. A loader that gives each thread shards of its own can use shard(i) directly, no locks.
+ * Lookups return a copy made under the shard lock, so nothing a caller keeps points into a shard
+ * another thread may change.
+ */
+class ShardedCourseTable
+{
+public:
+    // shards is rounded up to a power of two, 0 picks 4 per hardware thread
+    explicit ShardedCourseTable(size_t shards = 0, StorageMode storage = StorageMode::Chained)
+    {
+        size_t wanted = shards == 0 ? workerCount() * 4 : shards;
+        while ((size_t(1) << shardBits) < wanted) shardBits++;
+        parts.resize(size_t(1) << shardBits);
+        for (unique_ptr<Shard>& part : parts) part = make_unique<Shard>(storage);
+    }
+
+    void Insert(const Course& course)
+    {
+        Shard& part = *parts[shardOf(course.courseNumber)];
+        lock_guard<mutex> guard(part.lock);
+        part.table.Insert(course);
+    }
+
+    void insertFields(string_view courseNumber, string_view name, const string_view* prerequisites, size_t count)
+    {
+        Shard& part = *parts[shardOf(courseNumber)];
+        lock_guard<mutex> guard(part.lock);
+        part.table.insertFields(courseNumber, name, prerequisites, count);
+    }
+
+    Course searchCourse(const string& courseNumber) const
+    {
+        const Shard& part = *parts[shardOf(courseNumber)];
+        lock_guard<mutex> guard(part.lock);
+        return part.table.searchCourse(courseNumber);
+    }
+
+    size_t Size() const
+    {
+        size_t total = 0;
+        for (const unique_ptr<Shard>& part : parts)
+        {
+            lock_guard<mutex> guard(part->lock);
+            total += part->table.Size();
+        }
+        return total;
+    }
+
+    void Clear()
+    {
+        for (unique_ptr<Shard>& part : parts)
+        {
+            lock_guard<mutex> guard(part->lock);
+            part->table.Clear();
+        }
+    }
+
+    bool Remove(string_view courseNumber)
+    {
+        Shard& part = *parts[shardOf(courseNumber)];
+        lock_guard<mutex> guard(part.lock);
+        return part.table.Remove(courseNumber);
+    }
+
+    // bulk build, every shard sized for its share of courses
+    void reserve(size_t courses)
+    {
+        for (unique_ptr<Shard>& part : parts)
+        {
+            lock_guard<mutex> guard(part->lock);
+            part->table.reserve(courses / parts.size() + 1);
+        }
+    }
+
+    void printAll(ostream& out = cout) const;
+
+    size_t shardCount() const { return parts.size(); }
+    size_t shardOf(uint64_t h) const { return shardBits == 0 ? 0 : static_cast<size_t>(h >> (64 - shardBits)); }
+    size_t shardOf(string_view courseNumber) const { return shardOf(hashKey64(courseNumber)); }
+    // the shard itself, for a caller that makes sure nothing else uses it meanwhile
+    CourseHashTable& shard(size_t index) { return parts[index]->table; }
+    size_t memoryBytes() const
+    {
+        size_t bytes = sizeof(*this) + parts.capacity() * sizeof(unique_ptr<Shard>);
+        for (const unique_ptr<Shard>& part : parts) bytes += sizeof(Shard) - sizeof(CourseHashTable) + part->table.memoryBytes();
+        return bytes;
+    }
+
+private:
+    struct Shard
+    {
+        CourseHashTable table;
+        mutable mutex lock;
+
+        explicit Shard(StorageMode storage) : table(storage) {}
+    };
+
+    vector<unique_ptr<Shard>> parts; // separate allocations, so shard locks don't share cache lines
+    unsigned int shardBits = 0;
+};
+
+/**
+ * printAll
+ *
+ * Same output as CourseHashTable::printAll: every shard's sorted index is merged in course number
+ * order through a small heap, one cursor per shard.
+ */
+void ShardedCourseTable::printAll(ostream& out) const
+{
+    ScopedTimer timer(Op::PrintAll);
+    vector<unique_lock<mutex>> guards;
+    vector<vector<CourseView>> lists(parts.size());
+    size_t total = 0;
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+        guards.emplace_back(parts[i]->lock);
+        parts[i]->table.listCourses("", 0, SIZE_MAX, lists[i]);
+        total += lists[i].size();
+    }
+
+    // heap of (shard, position) with the smallest course number on top
+    vector<pair<size_t, size_t>> cursors;
+    auto later = [&lists](const pair<size_t, size_t>& a, const pair<size_t, size_t>& b)
+        {
+            return lists[a.first][a.second].courseNumber > lists[b.first][b.second].courseNumber;
+        };
+    for (size_t i = 0; i < lists.size(); i++)
+    {
+        if (!lists[i].empty()) cursors.emplace_back(i, 0);
+    }
+    make_heap(cursors.begin(), cursors.end(), later);
+
+    string buffer = "\nCourse List:\n============\n";
+    buffer.reserve(OUTPUT_FLUSH_BYTES + 4096);
+    while (!cursors.empty())
+    {
+        pop_heap(cursors.begin(), cursors.end(), later);
+        pair<size_t, size_t>& next = cursors.back();
+        const CourseView& course = lists[next.first][next.second];
+        buffer.append(course.courseNumber).append(", ").append(course.name).append("\n");
+        if (buffer.size() >= OUTPUT_FLUSH_BYTES)
+        {
+            out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            buffer.clear();
+        }
+        if (++next.second < lists[next.first].size()) push_heap(cursors.begin(), cursors.end(), later);
+        else cursors.pop_back();
+    }
+    buffer.append("\nTotal courses: ").append(to_string(total)).append("\n");
+    out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    out.flush();
+}
+
+//============================================================================
+// Prerequisite graph
+//============================================================================
+
+/**
+ * PrerequisiteGraph
+ *
+ * The prerequisite relation of a loaded table in CSR form (an offsets array plus one flat
+ * target array), once in each direction: prerequisites of a course and courses that depend on it.
+ * Nodes are CourseIds. Full chains are found with a BFS that marks visited nodes in a bitset.
+ * When the catalog is small enough, a transitive closure bitmatrix answers them by reading one row.
+ */
+class PrerequisiteGraph
+{
+public:
+    // range of ids out of one CSR row
+    struct Edges
+    {
+        const CourseId* first;
+        const CourseId* last;
+        const CourseId* begin() const { return first; }
+        const CourseId* end() const { return last; }
+        size_t size() const { return static_cast<size_t>(last - first); }
+    };
+
+    void build(const CourseHashTable& table);
+    bool buildClosure(size_t maxBytes = CLOSURE_MAX_BYTES);
+
+    Edges prerequisites(CourseId id) const { return row(prereqOffsets, prereqTargets, id); }
+    Edges dependents(CourseId id) const { return row(dependentOffsets, dependentTargets, id); }
+    vector<CourseId> ancestors(CourseId id) const; // every course needed before id
+    vector<CourseId> descendants(CourseId id) const; // every course that needs id
+    size_t nodeCount() const { return nodes; }
+    size_t edgeCount() const { return prereqTargets.size(); }
+    bool hasClosure() const { return !closure.empty(); }
+
+private:
+    size_t nodes = 0;
+    vector<uint32_t> prereqOffsets; // nodes + 1 entries
+    vector<CourseId> prereqTargets;
+    vector<uint32_t> dependentOffsets;
+    vector<CourseId> dependentTargets;
+    vector<uint64_t> closure; // nodes rows of closureWords, bit p of row v = p is an ancestor of v
+    size_t closureWords = 0;
+
+    static Edges row(const vector<uint32_t>& offsets, const vector<CourseId>& targets, CourseId id)
+    {
+        return Edges{ targets.data() + offsets[id], targets.data() + offsets[id + 1] };
+    }
+    vector<CourseId> reach(CourseId id, const vector<uint32_t>& offsets, const vector<CourseId>& targets) const;
+};
+
+/**
+ * build
+ *
+ * Counts the edges per node, prefix sums the counts into offsets, then fills the targets.
+ * Both directions come out of the same pass over the table.
+ *
+ * @param table to build from, ids are the table's interned ids.
+ */
+void PrerequisiteGraph::build(const CourseHashTable& table)
+{
+    nodes = table.idCount();
+    closure.clear();
+    closureWords = 0;
+    prereqOffsets.assign(nodes + 1, 0);
+    dependentOffsets.assign(nodes + 1, 0);
+
+    // count
+    table.forEachCourse([&](CourseId id, const CourseId* prereqs, size_t count)
+        {
+            prereqOffsets[id + 1] = static_cast<uint32_t>(count);
+            for (size_t i = 0; i < count; i++) dependentOffsets[prereqs[i] + 1]++;
+        });
+    for (size_t v = 0; v < nodes; v++)
+    {
+        prereqOffsets[v + 1] += prereqOffsets[v];
+        dependentOffsets[v + 1] += dependentOffsets[v];
+    }
+
+    // fill
+    prereqTargets.resize(prereqOffsets[nodes]);
+    dependentTargets.resize(dependentOffsets[nodes]);
+    vector<uint32_t> cursor(dependentOffsets.begin(), dependentOffsets.end() - 1);
+    table.forEachCourse([&](CourseId id, const CourseId* prereqs, size_t count)
+        {
+            copy(prereqs, prereqs + count, prereqTargets.begin() + prereqOffsets[id]);
+            for (size_t i = 0; i < count; i++) dependentTargets[cursor[prereqs[i]]++] = id;
+        });
+}
+
+/**
+ * buildClosure
+ *
+ * Builds the transitive closure bitmatrix in topological order, so each row is the OR of its
+ * prerequisites' rows plus their own bits.
+ *
+ * @param maxBytes the matrix may use.
+ * @return false if the catalog is too big for maxBytes or the graph has a cycle, queries then use BFS.
+ */
+bool PrerequisiteGraph::buildClosure(size_t maxBytes)
+{
+    closure.clear();
+    closureWords = (nodes + 63) / 64;
+    if (nodes == 0 || closureWords * nodes * sizeof(uint64_t) > maxBytes)
+    {
+        closureWords = 0;
+        return false;
+    }
+
+    // Kahn's algorithm, prerequisites come before the courses that need them
+    vector<uint32_t> remaining(nodes);
+    vector<CourseId> order;
+    order.reserve(nodes);
+    for (CourseId v = 0; v < nodes; v++)
+    {
+        remaining[v] = static_cast<uint32_t>(prerequisites(v).size());
+        if (remaining[v] == 0) order.push_back(v);
+    }
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        for (CourseId dependent : dependents(order[i]))
+        {
+            if (--remaining[dependent] == 0) order.push_back(dependent);
+        }
+    }
+    if (order.size() != nodes)
+    {
+        // cycle, no topological order to build rows in
+        closureWords = 0;
+        return false;
+    }
+
+    closure.assign(closureWords * nodes, 0);
+    for (CourseId v : order)
+    {
+        uint64_t* target = &closure[v * closureWords];
+        for (CourseId prereq : prerequisites(v))
+        {
+            const uint64_t* source = &closure[prereq * closureWords];
+            for (size_t w = 0; w < closureWords; w++) target[w] |= source[w];
+            target[prereq / 64] |= uint64_t(1) << (prereq % 64);
+        }
+    }
+    return true;
+}
+
+/**
+ * reach
+ *
+ * BFS over one direction of the graph with a visited bitset.
+ * @return every node reachable from id, not including id.
+ */
+vector<CourseId> PrerequisiteGraph::reach(CourseId id, const vector<uint32_t>& offsets, const vector<CourseId>& targets) const
+{
+    vector<uint64_t> visited((nodes + 63) / 64, 0);
+    vector<CourseId> found;
+    visited[id / 64] |= uint64_t(1) << (id % 64);
+    found.push_back(id);
+    for (size_t i = 0; i < found.size(); i++)
+    {
+        for (CourseId next : row(offsets, targets, found[i]))
+        {
+            uint64_t bit = uint64_t(1) << (next % 64);
+            if (visited[next / 64] & bit) continue;
+            visited[next / 64] |= bit;
+            found.push_back(next);
+        }
+    }
+    found.erase(found.begin());
+    return found;
+}
+
+/**
+ * ancestors
+ *
+ * @param id of the course.
+ * @return the full prerequisite chain of the course, read from the closure row when there is one.
+ */
+vector<CourseId> PrerequisiteGraph::ancestors(CourseId id) const
+{
+    if (id >= nodes) return {};
+    if (!hasClosure()) return reach(id, prereqOffsets, prereqTargets);
+
+    vector<CourseId> found;
+    const uint64_t* bits = &closure[id * closureWords];
+    for (size_t w = 0; w < closureWords; w++)
+    {
+        for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+        {
+            // index of the lowest set bit
+            unsigned int bit = 0;
+            while (!((word >> bit) & 1)) bit++;
+            found.push_back(static_cast<CourseId>(w * 64 + bit));
+        }
+    }
+    return found;
+}
+
+/**
+ * descendants
+ *
+ * @param id of the course.
+ * @return every course that has it somewhere in its prerequisite chain.
+ */
+vector<CourseId> PrerequisiteGraph::descendants(CourseId id) const
+{
+    if (id >= nodes) return {};
+    return reach(id, dependentOffsets, dependentTargets);
+}
+
+//============================================================================
+// Semester planning
+//============================================================================
+
+/**
+ * Result of planSemesters.
+ * terms[t] holds the courses of term t + 1. If the prerequisites have a cycle, valid is false,
+ * cycle holds one cycle in prerequisite order with its first course repeated at the end,
+ * and stuck counts every course that can never be scheduled.
+ */
+struct SemesterPlan
+{
+    bool valid = true;
+    vector<vector<CourseId>> terms;
+    vector<CourseId> cycle;
+    size_t stuck = 0;
+};
+
+/**
+ * earliestTerms
+ *
+ * Level synchronous Kahn's algorithm: level 0 is every course without prerequisites, and a course
+ * joins the next level when its last prerequisite is placed. So each level is the earliest term the
+ * course can be taken. Big frontiers are split over threads, and the remaining prerequisite counts
+ * are atomics so any thread can release a dependent.
+ *
+ * @param graph to plan over, levels gets the 0 based level per node (UINT32_MAX if never reached).
+ * @return the levels in order.
+ */
+vector<vector<CourseId>> earliestTerms(const PrerequisiteGraph& graph, vector<uint32_t>& levels)
+{
+    size_t nodes = graph.nodeCount();
+    vector<atomic<uint32_t>> remaining(nodes);
+    vector<CourseId> frontier;
+    levels.assign(nodes, UINT32_MAX);
+    for (CourseId v = 0; v < nodes; v++)
+    {
+        uint32_t count = static_cast<uint32_t>(graph.prerequisites(v).size());
+        remaining[v].store(count, memory_order_relaxed);
+        if (count == 0) frontier.push_back(v);
+    }
+
+    vector<vector<CourseId>> terms;
+    while (!frontier.empty())
+    {
+        uint32_t level = static_cast<uint32_t>(terms.size());
+        for (CourseId v : frontier) levels[v] = level;
+
+        // each part of the frontier collects the dependents it released
+        size_t parts = frontier.size() < PARALLEL_FRONTIER ? 1 : workerCount();
+        vector<vector<CourseId>> released(parts);
+        parallelFor(parts, [&](size_t part)
+            {
+                size_t begin = frontier.size() * part / parts;
+                size_t end = frontier.size() * (part + 1) / parts;
+                for (size_t i = begin; i < end; i++)
+                {
+                    for (CourseId dependent : graph.dependents(frontier[i]))
+                    {
+                        if (remaining[dependent].fetch_sub(1, memory_order_acq_rel) == 1)
+                        {
+                            released[part].push_back(dependent);
+                        }
+                    }
+                }
+            });
+
+        terms.push_back(move(frontier));
+        frontier.clear();
+        for (vector<CourseId>& part : released)
+        {
+            frontier.insert(frontier.end(), part.begin(), part.end());
+        }
+    }
+    return terms;
+}
+
+/**
+ * findCycle
+ *
+ * Every node that was never leveled still waits on an unleveled prerequisite,
+ * so following those prerequisites has to come back around. The first repeat closes the cycle.
+ *
+ * @param graph, levels from earliestTerms.
+ * @return the cycle in prerequisite order, first course repeated at the end.
+ */
+vector<CourseId> findCycle(const PrerequisiteGraph& graph, const vector<uint32_t>& levels)
+{
+    CourseId start = INVALID_COURSE_ID;
+    for (CourseId v = 0; v < levels.size() && start == INVALID_COURSE_ID; v++)
+    {
+        if (levels[v] == UINT32_MAX) start = v;
+    }
+    if (start == INVALID_COURSE_ID) return {};
+
+    vector<uint32_t> seenAt(levels.size(), UINT32_MAX); // position in path
+    vector<CourseId> path;
+    CourseId v = start;
+    while (seenAt[v] == UINT32_MAX)
+    {
+        seenAt[v] = static_cast<uint32_t>(path.size());
+        path.push_back(v);
+        for (CourseId prereq : graph.prerequisites(v))
+        {
+            if (levels[prereq] == UINT32_MAX)
+            {
+                v = prereq;
+                break;
+            }
+        }
+    }
+    // the walk went course -> prerequisite, reverse it so it reads prerequisite first
+    vector<CourseId> cycle(path.begin() + seenAt[v], path.end());
+    reverse(cycle.begin(), cycle.end());
+    cycle.push_back(cycle.front());
+    return cycle;
+}
+
+/**
+ * planSemesters
+ *
+ * Orders the catalog into terms so every course comes after all of its prerequisites.
+ * Without a limit every term is one earliest-term level. With maxPerTerm, each term takes up
+ * to that many of the ready courses, earliest level first, and a course is ready once all its
+ * prerequisites are in earlier terms.
+ *
+ * @param graph to plan, maxPerTerm caps the courses per term (0 for no limit).
+ * @return the plan, or the cycle that makes planning impossible.
+ */
+SemesterPlan planSemesters(const PrerequisiteGraph& graph, size_t maxPerTerm = 0)
+{
+    SemesterPlan plan;
+    vector<uint32_t> levels;
+    vector<vector<CourseId>> layers = earliestTerms(graph, levels);
+
+    size_t placed = 0;
+    for (const vector<CourseId>& layer : layers) placed += layer.size();
+    if (placed != graph.nodeCount())
+    {
+        plan.valid = false;
+        plan.stuck = graph.nodeCount() - placed;
+        plan.cycle = findCycle(graph, levels);
+        return plan;
+    }
+
+    if (maxPerTerm == 0)
+    {
+        plan.terms = move(layers);
+        return plan;
+    }
+
+    // list scheduling, lowest (level, id) first
+    using Entry = pair<uint32_t, CourseId>;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> ready;
+    vector<uint32_t> remaining(graph.nodeCount());
+    for (CourseId v = 0; v < graph.nodeCount(); v++)
+    {
+        remaining[v] = static_cast<uint32_t>(graph.prerequisites(v).size());
+        if (remaining[v] == 0) ready.push(Entry(levels[v], v));
+    }
+    while (!ready.empty())
+    {
+        vector<CourseId> term;
+        while (!ready.empty() && term.size() < maxPerTerm)
+        {
+            term.push_back(ready.top().second);
+            ready.pop();
+        }
+        // dependents only become ready for the next term
+        for (CourseId v : term)
+        {
+            for (CourseId dependent : graph.dependents(v))
+            {
+                if (--remaining[dependent] == 0) ready.push(Entry(levels[dependent], dependent));
+            }
+        }
+        plan.terms.push_back(move(term));
+    }
+    return plan;
+}
+
+//============================================================================
+// Columnar catalog
+//============================================================================
+
+/**
+ * CourseColumns
+ *
+ * Read only, structure of arrays copy of a loaded catalog for reports that scan every course.
+ * Rows are in course number order and each field is its own contiguous array: packed keys, name
+ * offsets into one string blob, prerequisite counts and offsets into one id array, and the level
+ * digit. A filter reads only the column it tests and ANDs its result into a byte per row mask,
+ * the loops are branch free so the compiler vectorizes them. Every row also has its department,
+ * the letters a course number starts with, as an index into the sorted department names.
+ */
+class CourseColumns
+{
+public:
+    using RowMask = vector<uint8_t>; // 1 keeps the row
+    static constexpr uint8_t NO_LEVEL = 10; // level of a course number without a digit
+    static constexpr size_t LEVELS = 11; // level digits 0 to 9, then NO_LEVEL
+
+    void build(const CourseHashTable& table);
+
+    size_t size() const { return ids.size(); }
+    // long course numbers point into the table's strings, so the columns can't outlive the table
+    string_view courseNumber(size_t row) const { return keys[row].view(); }
+    string_view name(size_t row) const
+    {
+        return string_view(names.data() + nameOffsets[row], static_cast<size_t>(nameOffsets[row + 1] - nameOffsets[row]));
+    }
+    CourseId courseId(size_t row) const { return ids[row]; }
+    const CourseId* prerequisites(size_t row) const { return prerequisiteIds.data() + prerequisiteOffsets[row]; }
+    uint32_t prerequisiteCount(size_t row) const { return prerequisiteCounts[row]; }
+    uint8_t level(size_t row) const { return levels[row]; }
+    size_t departmentCount() const { return departmentNames.size(); }
+    const string& departmentName(size_t department) const { return departmentNames[department]; }
+    size_t memoryBytes() const;
+
+    // filters, each narrows a mask that starts out as allRows()
+    RowMask allRows() const { return RowMask(size(), 1); }
+    void keepPrefix(RowMask& mask, string_view prefix) const;
+    void keepPrerequisites(RowMask& mask, uint32_t minCount, uint32_t maxCount) const;
+    void keepLevel(RowMask& mask, uint8_t digit) const;
+
+    // aggregates over the rows a mask keeps
+    size_t count(const RowMask& mask) const;
+    vector<size_t> countByDepartment(const RowMask& mask) const;
+    vector<size_t> countByLevel(const RowMask& mask) const;
+    uint64_t sumPrerequisites(const RowMask& mask) const;
+    uint32_t maxPrerequisites(const RowMask& mask) const;
+    void selectRows(const RowMask& mask, vector<uint32_t>& rows) const;
+
+private:
+    vector<CourseKey> keys;
+    vector<CourseId> ids;
+    vector<uint64_t> nameOffsets; // rows + 1 entries into names
+    string names;
+    vector<uint32_t> prerequisiteCounts;
+    vector<uint32_t> prerequisiteOffsets; // rows + 1 entries into prerequisiteIds
+    vector<CourseId> prerequisiteIds;
+    vector<uint8_t> levels;
+    vector<string> departmentNames; // sorted
+    vector<uint32_t> departments; // per row, index into departmentNames
+};
+
+/**
+ * build
+ *
+ * Ranks the courses by the table's sorted index, then two passes over the table in storage
+ * order: the first sizes each row's name and prerequisites, the prefix sums of those place
+ * every row in the blobs, and the second copies them in.
+ *
+ * @param table to copy, ids stay the table's interned ids.
+ */
+void CourseColumns::build(const CourseHashTable& table)
+{
+    ids = table.sortedCourseIds();
+    size_t rows = ids.size();
+    vector<uint32_t> rank(table.idCount(), UINT32_MAX);
+    for (size_t r = 0; r < rows; r++) rank[ids[r]] = static_cast<uint32_t>(r);
+
+    // sizes
+    nameOffsets.assign(rows + 1, 0);
+    prerequisiteCounts.assign(rows, 0);
+    table.forEachView([&](const CourseView& course)
+        {
+            uint32_t r = rank[course.id];
+            nameOffsets[r + 1] = course.name.size();
+            prerequisiteCounts[r] = static_cast<uint32_t>(course.prerequisiteCount);
+        });
+    prerequisiteOffsets.assign(rows + 1, 0);
+    for (size_t r = 0; r < rows; r++)
+    {
+        nameOffsets[r + 1] += nameOffsets[r];
+        prerequisiteOffsets[r + 1] = prerequisiteOffsets[r] + prerequisiteCounts[r];
+    }
+
+    // contents
+    names.resize(static_cast<size_t>(nameOffsets[rows]));
+    prerequisiteIds.resize(prerequisiteOffsets[rows]);
+    table.forEachView([&](const CourseView& course)
+        {
+            uint32_t r = rank[course.id];
+            if (!course.name.empty()) memcpy(&names[static_cast<size_t>(nameOffsets[r])], course.name.data(), course.name.size());
+            copy(course.prerequisiteIds, course.prerequisiteIds + course.prerequisiteCount, prerequisiteIds.begin() + prerequisiteOffsets[r]);
+        });
+
+    // keys, levels and departments, in row order
+    keys.resize(rows);
+    levels.resize(rows);
+    departments.resize(rows);
+    // a department's rows aren't always next to each other ("CS", "CS A", "CS1" sort around
+    // other prefixes), so they're numbered by first appearance and renumbered in name order
+    unordered_map<string_view, uint32_t> seen;
+    vector<string_view> found;
+    for (size_t r = 0; r < rows; r++)
+    {
+        string_view number = table.courseNumberOf(ids[r]);
+        keys[r] = CourseKey(number);
+        size_t digit = number.find_first_of("0123456789");
+        levels[r] = digit == string_view::npos ? NO_LEVEL : static_cast<uint8_t>(number[digit] - '0');
+        size_t letters = 0;
+        while (letters < number.size() && isalpha(static_cast<unsigned char>(number[letters]))) letters++;
+        auto entry = seen.emplace(number.substr(0, letters), static_cast<uint32_t>(found.size()));
+        if (entry.second) found.push_back(entry.first->first);
+        departments[r] = entry.first->second;
+    }
+    vector<uint32_t> order(found.size());
+    for (uint32_t d = 0; d < order.size(); d++) order[d] = d;
+    sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return found[a] < found[b]; });
+    vector<uint32_t> renumber(found.size());
+    departmentNames.clear();
+    for (uint32_t d = 0; d < order.size(); d++)
+    {
+        renumber[order[d]] = d;
+        departmentNames.emplace_back(found[order[d]]);
+    }
+    for (uint32_t& department : departments) department = renumber[department];
+}
+
+// bytes held by the columns
+size_t CourseColumns::memoryBytes() const
+{
+    size_t bytes = keys.capacity() * sizeof(CourseKey) + ids.capacity() * sizeof(CourseId) + nameOffsets.capacity() * sizeof(uint64_t)
+        + names.capacity() + (prerequisiteCounts.capacity() + prerequisiteOffsets.capacity() + departments.capacity()) * sizeof(uint32_t)
+        + prerequisiteIds.capacity() * sizeof(CourseId) + levels.capacity();
+    for (const string& department : departmentNames) bytes += sizeof(string) + department.capacity();
+    return bytes;
+}
+
+/**
+ * keepPrefix
+ *
+ * Course numbers starting with prefix are one range of rows, found by binary search, so only
+ * the mask outside it is cleared.
+ */
+void CourseColumns::keepPrefix(RowMask& mask, string_view prefix) const
+{
+    auto first = lower_bound(keys.begin(), keys.end(), prefix, [](const CourseKey& key, string_view value)
+        {
+            return key.view() < value;
+        });
+    auto last = partition_point(first, keys.end(), [prefix](const CourseKey& key)
+        {
+            return key.view().substr(0, prefix.size()) == prefix;
+        });
+    fill(mask.begin(), mask.begin() + (first - keys.begin()), 0);
+    fill(mask.begin() + (last - keys.begin()), mask.end(), 0);
+}
+
+/**
+ * keepPrerequisites
+ *
+ * Keeps rows with minCount to maxCount prerequisites. One unsigned compare tests both bounds.
+ */
+void CourseColumns::keepPrerequisites(RowMask& mask, uint32_t minCount, uint32_t maxCount) const
+{
+    if (minCount > maxCount)
+    {
+        fill(mask.begin(), mask.end(), 0);
+        return;
+    }
+    const uint32_t* counts = prerequisiteCounts.data();
+    uint8_t* keep = mask.data();
+    uint32_t span = maxCount - minCount;
+    for (size_t r = 0; r < mask.size(); r++) keep[r] &= static_cast<uint8_t>(counts[r] - minCount <= span);
+}
+
+/**
+ * keepLevel
+ *
+ * Keeps rows whose course number's first digit is digit (NO_LEVEL for numbers without one).
+ */
+void CourseColumns::keepLevel(RowMask& mask, uint8_t digit) const
+{
+    const uint8_t* level = levels.data();
+    uint8_t* keep = mask.data();
+    for (size_t r = 0; r < mask.size(); r++) keep[r] &= static_cast<uint8_t>(level[r] == digit);
+}
+
+// rows the mask keeps
+size_t CourseColumns::count(const RowMask& mask) const
+{
+    size_t total = 0;
+    for (uint8_t keep : mask) total += keep;
+    return total;
+}
+
+// count per department, in departmentName order
+vector<size_t> CourseColumns::countByDepartment(const RowMask& mask) const
+{
+    vector<size_t> counts(departmentNames.size(), 0);
+    for (size_t r = 0; r < mask.size(); r++) counts[departments[r]] += mask[r];
+    return counts;
+}
+
+// count per level digit, NO_LEVEL last
+vector<size_t> CourseColumns::countByLevel(const RowMask& mask) const
+{
+    vector<size_t> counts(LEVELS, 0);
+    for (size_t r = 0; r < mask.size(); r++) counts[levels[r]] += mask[r];
+    return counts;
+}
+
+// prerequisites of the kept rows in total
+uint64_t CourseColumns::sumPrerequisites(const RowMask& mask) const
+{
+    uint64_t total = 0;
+    for (size_t r = 0; r < mask.size(); r++) total += prerequisiteCounts[r] * static_cast<uint64_t>(mask[r]);
+    return total;
+}
+
+// most prerequisites of a kept row, 0 if none is kept
+uint32_t CourseColumns::maxPrerequisites(const RowMask& mask) const
+{
+    uint32_t most = 0;
+    for (size_t r = 0; r < mask.size(); r++) most = max(most, prerequisiteCounts[r] * mask[r]);
+    return most;
+}
+
+/**
+ * selectRows
+ *
+ * The kept row numbers, in course number order. Every row is written and the output position
+ * only advances for a kept one, so there's no branch on the mask.
+ */
+void CourseColumns::selectRows(const RowMask& mask, vector<uint32_t>& rows) const
+{
+    rows.resize(mask.size());
+    size_t kept = 0;
+    for (size_t r = 0; r < mask.size(); r++)
+    {
+        rows[kept] = static_cast<uint32_t>(r);
+        kept += mask[r];
+    }
+    rows.resize(kept);
+}
+
+//============================================================================
+// Published catalogs
+//============================================================================
+
+/**
+ * Catalog
+ *
+ * One loaded catalog: the table and the prerequisite graph built from it. Once it's published
+ * it's only read, a reload builds a new one. The columnar copy for reports is built by the first
+ * report that asks for it, once, whichever thread that is.
+ */
+struct Catalog
+{
+    CourseHashTable table;
+    PrerequisiteGraph graph;
+
+    explicit Catalog(StorageMode storage = StorageMode::Chained) : table(storage) {}
+
+    const CourseColumns& columns() const
+    {
+        call_once(columnsBuilt, [this]() { columnCopy.build(table); });
+        return columnCopy;
+    }
+
+private:
+    mutable once_flag columnsBuilt;
+    mutable CourseColumns columnCopy;
+};
+
+/**
+ * CatalogStore
+ *
+ * Hands the current catalog to any number of reader threads while a reload builds the next one
+ * aside. Readers pin the current epoch in a slot of their own and load the catalog pointer: no
+ * lock and no write to a shared cache line, so lookups scale with the reader count and never
+ * wait for a load. publish() swaps the pointer and retires the old catalog under the epoch of the
+ * swap. collect() frees retired catalogs once every pinned reader has an epoch after theirs,
+ * readers that might still see one keep it alive (epoch based reclamation).
+ */
+class CatalogStore
+{
+public:
+    static constexpr size_t MAX_READERS = 128; // readers pinned at the same time, more wait for a slot
+
+    /**
+     * Reader
+     *
+     * Pins the catalog that was current when it was made, for as long as it lives.
+     * Views from the catalog's table stay valid until then, reloads or not.
+     */
+    class Reader
+    {
+    public:
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        ~Reader()
+        {
+            Slot& own = store.slots[slot];
+            own.epoch.store(IDLE, memory_order_release);
+            own.taken.store(false, memory_order_release);
+        }
+
+        const Catalog& operator*() const { return *catalog; }
+        const Catalog* operator->() const { return catalog; }
+
+    private:
+        friend class CatalogStore;
+        const CatalogStore& store;
+        size_t slot;
+        const Catalog* catalog;
+
+        explicit Reader(const CatalogStore& owner) : store(owner), slot(owner.claimSlot())
+        {
+            // the pin has to be visible before the pointer is read, both are sequentially consistent
+            store.slots[slot].epoch.store(store.epoch.load());
+            catalog = store.current.load();
+        }
+    };
+
+    CatalogStore() : current(new Catalog()) {}
+    ~CatalogStore()
+    {
+        // no readers are left by now
+        for (const pair<uint64_t, Catalog*>& old : retired) delete old.second;
+        delete current.load();
+    }
+    CatalogStore(const CatalogStore&) = delete;
+    CatalogStore& operator=(const CatalogStore&) = delete;
+
+    Reader read() const { return Reader(*this); }
+
+    /**
+     * publish
+     *
+     * Makes next the catalog new readers get. Readers already pinned keep the old one, it's freed
+     * by a later collect(). Safe from any thread, writers take turns.
+     */
+    void publish(unique_ptr<Catalog> next)
+    {
+        lock_guard<mutex> guard(writerLock);
+        Catalog* old = current.exchange(next.release());
+        retired.emplace_back(epoch.fetch_add(1), old);
+        versions++;
+        collectLocked();
+    }
+
+    // frees the retired catalogs no reader can see anymore, returns how many are still waiting
+    size_t collect()
+    {
+        lock_guard<mutex> guard(writerLock);
+        return collectLocked();
+    }
+
+    uint64_t version() const { return versions.load(); } // catalogs published so far
+
+private:
+    static constexpr uint64_t IDLE = UINT64_MAX;
+
+    // own cache line per slot, so readers don't slow each other down
+    struct alignas(64) Slot
+    {
+        atomic<uint64_t> epoch{ IDLE }; // epoch the reader pinned, IDLE when it's free
+        atomic<bool> taken{ false };
+    };
+
+    mutable Slot slots[MAX_READERS];
+    atomic<Catalog*> current;
+    atomic<uint64_t> epoch{ 1 };
+    atomic<uint64_t> versions{ 0 };
+    mutex writerLock;
+    vector<pair<uint64_t, Catalog*>> retired; // epoch of the swap and the catalog it replaced
+
+    // a free slot, a thread starts looking at the one it had last time so it's usually free
+    size_t claimSlot() const
+    {
+        thread_local size_t hint = hash<thread::id>()(this_thread::get_id()) % MAX_READERS;
+        for (size_t tries = 0; ; tries++)
+        {
+            size_t i = (hint + tries) % MAX_READERS;
+            if (!slots[i].taken.load(memory_order_relaxed) && !slots[i].taken.exchange(true, memory_order_acquire))
+            {
+                hint = i;
+                return i;
+            }
+            // every slot is in use, give the readers holding them a chance to finish
+            if (tries % MAX_READERS == MAX_READERS - 1) this_thread::yield();
+        }
+    }
+
+    size_t collectLocked()
+    {
+        uint64_t oldest = IDLE;
+        for (const Slot& slot : slots) oldest = min(oldest, slot.epoch.load());
+        // a reader pinned at an epoch after the swap loaded the new pointer
+        auto reclaimable = [oldest](const pair<uint64_t, Catalog*>& old) { return old.first < oldest; };
+        for (const pair<uint64_t, Catalog*>& old : retired)
+        {
+            if (reclaimable(old)) delete old.second;
+        }
+        retired.erase(remove_if(retired.begin(), retired.end(), reclaimable), retired.end());
+        return retired.size();
+    }
+};
+
+//============================================================================
+// unnamed namespace continued for loadCourses and displayInformation
+// Could be moved up top but requires forward declarations. I prefer this. 
+//============================================================================
+
+namespace 
+{
+    // how loadCourses reads the file
+    enum class LoadMode
+    {
+        Stream, // getline, one record at a time, the original path
+        Mapped, // memory mapped, fields are views into the file
+        Parallel, // memory mapped, chunks parsed and validated on all cores
+        Pipelined // reads, parsing and inserts overlapped on three threads, the file is never all in memory
+    };
+
+    // smallest chunk worth handing to its own thread in the parallel loader
+    constexpr size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+    // a parsed line, prerequisites are a range in a shared prereqs vector
+    struct ParsedCourse
+    {
+        string_view courseNumber;
+        string_view name;
+        size_t firstPrereq;
+        size_t prereqCount;
+        int lineNumber; // line in the file (chunk local while the parallel loader parses)
+        CourseId id; // interned id, only set by loaders that intern while parsing
+    };
+
+    /**
+     * parseCourseFields
+     *
+     * Checks one record's fields, the per-record validation shared by the loaders.
+     *
+     * @param fields of the record, count of them, prereqs collects the prerequisite views.
+     * @param course is filled in on success, error gets the message (after "Error line N: ") on failure.
+     * @return true if the record is a valid course.
+     */
+    bool parseCourseFields(const string_view* fields, size_t count, vector<string_view>& prereqs, ParsedCourse& course, string& error)
+    {
+        // validation for minimum fields and non-empty fields (courseNumber and name)
+        if (count < 2)
+        {
+            error = "Missing course number or name.";
+            return false;
+        }
+        if (fields[0].empty() || fields[1].empty())
+        {
+            error = "Empty course number or name.";
+            return false;
+        }
+
+        course.courseNumber = fields[0];
+        course.name = fields[1];
+        course.firstPrereq = prereqs.size();
+        course.prereqCount = 0;
+        for (size_t i = 2; i < count; i++)
+        {
+            string_view prereq = fields[i];
+            if (prereq.empty()) continue;
+            // validate prereqs format
+            if (prereq.length() < 4 || !containsDigit(prereq))
+            {
+                error = "Invalid prerequisite format '" + string(prereq) + "'";
+                prereqs.resize(course.firstPrereq);
+                return false;
+            }
+            prereqs.push_back(prereq);
+            course.prereqCount++;
+        }
+        return true;
+    }
+
+    // stream buffer that throws everything away, used to silence cout during benchmarks
+    class NullBuffer : public streambuf
+    {
+    protected:
+        int overflow(int c) override { return c; }
+    };
+
+	/**
+	 * Load a CSV file containing course information into a container
+	 * The original getline path, see loadCourses.
+	 *
+	 * @param filePath the path to the CSV file to load, ht is a pointer to the hash table class.
+	 * @return a container holding all the courses
+	 */
+
+    bool loadCoursesStream(const string& filePath, CourseHashTable* ht)
+    {
+        unordered_set<CourseKey, CourseKeyHash> courseNumbers; // track valid courses, long keys point into courses
+        deque<Course> courses; // track what's inserted for validation, a deque so the course numbers don't move
+        int lineNumber = 0; // track line numbers
+
+        // open filePath for reading
+        ifstream file(filePath);
+        // if open fails
+        if (!file.is_open())
+        {
+            cout << "Error: Could not open file " << filePath << endl;
+            return false;
+        }
+
+        // print "Loading file path " + filePath
+        cout << "Loading courses from " << filePath << endl;
+        // start clean, clear existing data if there is any.
+        ht->Clear();
+        // size the table once, guessing one course per 40 bytes of file
+        file.seekg(0, ios::end);
+        ht->reserve(static_cast<size_t>(max<streamoff>(0, file.tellg())) / 40 + 1);
+        file.seekg(0, ios::beg);
+
+        // read and parse lines and build course objects, the inserts in here are also timed as Insert
+        ScopedTimer parsePhase(Op::LoadParse);
+        // for each line in file
+        string line, more;
+        vector<string_view> fields;
+        StringArena unescaped;
+        bool firstRecord = true;
+        while (getline(file, line))
+        {
+            lineNumber++;
+            int recordLine = lineNumber;
+            // a quoted field can go on over several lines, read on until the quotes are balanced
+            size_t quotes = count(line.begin(), line.end(), '"');
+            while (quotes % 2 != 0 && getline(file, more))
+            {
+                lineNumber++;
+                line.append("\n").append(more);
+                quotes += count(more.begin(), more.end(), '"');
+            }
+
+            // same RFC 4180 reader as the mapped loaders, over the one record
+            unescaped.Reset();
+            CsvReader reader(line, unescaped, false);
+            if (!reader.next(fields))
+            {
+                // if line is blank, continue to next line
+                if (reader.error().empty()) continue;
+                cout << "Error line " << recordLine + reader.line() - 1 << ": " << reader.error() << endl;
+                file.close();
+                ht->Clear();
+                return false;
+            }
+            // a first row with a column name for its course number is a header
+            if (firstRecord)
+            {
+                firstRecord = false;
+                if (isHeaderField(fields[0])) continue;
+            }
+
+            // validation for minimum fields and non-empty fields (courseNumber and name)
+            if (fields.size() < 2)
+            {
+                cout << "Error line " << recordLine << ": Missing course number or name." << endl;
+                file.close();
+                ht->Clear();
+                return false;
+            }
+            if (fields[0].empty() || fields[1].empty())
+            {
+                cout << "Error line " << recordLine << ": Empty course number or name." << endl;
+                file.close();
+                ht->Clear();
+                return false;
+            }
+            // build course object
+            Course course;
+            course.courseNumber = string(fields[0]);
+            course.name = string(fields[1]);
+
+            // add prerequisites
+            for (size_t i = 2; i < fields.size(); i++)
+            {
+                string_view prereq = fields[i];
+                if (prereq.empty()) continue;
+                // validate prereqs format
+                if (prereq.length() < 4 || !containsDigit(prereq))
+                {
+                    cout << "Error line " << recordLine << ": Invalid prerequisite format '" << prereq << "'" << endl;
+                    file.close();
+                    ht->Clear();
+                    return false;
+                }
+                course.prerequisites.emplace_back(prereq);
+            }
+            // check for duplicates
+            if (courseNumbers.count(CourseKey(course.courseNumber)) > 0)
+            {
+                cout << "Error line " << recordLine << ": Duplicate course " << course.courseNumber << endl;
+                file.close();
+                ht->Clear();
+                return false;
+            }
+
+            ht->Insert(course);
+            courses.push_back(move(course));
+            courseNumbers.insert(CourseKey(courses.back().courseNumber));
+        }
+        file.close();
+        parsePhase.stop();
+
+        // validate prerequisites exist
+        ScopedTimer validatePhase(Op::LoadValidate);
+        for (const Course& course : courses)
+        {
+            for (const string& prereq : course.prerequisites)
+            {
+                if (courseNumbers.count(CourseKey(prereq)) == 0)
+                {
+                    cout << "Error: Unknown prerequisite " << prereq << " for course " << course.courseNumber << endl;
+                    ht->Clear();
+                    return false;
+                }
+            }
+        }
+
+        validatePhase.stop();
+
+        // finish any resize still in progress so lookups only check one bucket array
+        ht->finishRehash();
+        cout << "Successfully loaded " << courseNumbers.size() << " courses.\n";
+        return true;
+
+
+    }
+
+    /**
+     * loadCoursesMapped
+     *
+     * Memory maps the file and tokenizes it in place. Course numbers are interned as they're read,
+     * so the duplicate and prerequisite checks are lookups in an id indexed array. Each course is
+     * then inserted once with insertInterned, so its strings are only materialized in the table. Same checks, messages and line numbers
+     * as loadCoursesStream.
+     *
+     * @param filePath the path to the CSV file to load, ht is a pointer to the hash table class.
+     * @return true if the whole file loaded.
+     */
+    bool loadCoursesMapped(const string& filePath, CourseHashTable* ht)
+    {
+        MappedFile file;
+        if (!file.open(filePath))
+        {
+            cout << "Error: Could not open file " << filePath << endl;
+            return false;
+        }
+
+        cout << "Loading courses from " << filePath << endl;
+        ht->Clear();
+
+        string_view data = file.view();
+        vector<ParsedCourse> courses;
+        vector<string_view> prereqs;
+        vector<CourseId> prereqIds; // interned prereqs, same positions as prereqs
+        vector<char> defined; // per id, set once a line defines that course
+        vector<string_view> fields;
+        StringArena unescaped; // quoted fields with "" in them
+        string error;
+        // rough guess of one course per 40 bytes so the containers don't keep regrowing
+        courses.reserve(data.size() / 40 + 1);
+
+        ScopedTimer parsePhase(Op::LoadParse);
+        CsvReader reader(data, unescaped);
+        while (reader.next(fields))
+        {
+            int lineNumber = reader.line();
+            ParsedCourse course;
+            if (!parseCourseFields(fields.data(), fields.size(), prereqs, course, error))
+            {
+                cout << "Error line " << lineNumber << ": " << error << endl;
+                ht->Clear();
+                return false;
+            }
+            course.lineNumber = lineNumber;
+            // intern as we go, from here on the checks are array lookups
+            course.id = ht->intern(course.courseNumber);
+            for (size_t i = 0; i < course.prereqCount; i++)
+            {
+                prereqIds.push_back(ht->intern(prereqs[course.firstPrereq + i]));
+            }
+            if (defined.size() < ht->idCount()) defined.resize(max(ht->idCount(), defined.size() * 2));
+            // check for duplicates
+            if (defined[course.id])
+            {
+                cout << "Error line " << lineNumber << ": Duplicate course " << course.courseNumber << endl;
+                ht->Clear();
+                return false;
+            }
+            defined[course.id] = true;
+            courses.push_back(course);
+        }
+        if (!reader.error().empty())
+        {
+            cout << "Error line " << reader.line() << ": " << reader.error() << endl;
+            ht->Clear();
+            return false;
+        }
+
+        parsePhase.stop();
+
+        // validate prerequisites exist, before anything goes into the table
+        ScopedTimer validatePhase(Op::LoadValidate);
+        for (const ParsedCourse& course : courses)
+        {
+            for (size_t i = 0; i < course.prereqCount; i++)
+            {
+                if (!defined[prereqIds[course.firstPrereq + i]])
+                {
+                    cout << "Error: Unknown prerequisite " << prereqs[course.firstPrereq + i] << " for course " << course.courseNumber << endl;
+                    ht->Clear();
+                    return false;
+                }
+            }
+        }
+
+        validatePhase.stop();
+
+        ScopedTimer insertPhase(Op::LoadInsert);
+        // the count is exact by now, so the table is sized once
+        ht->reserve(courses.size());
+        for (const ParsedCourse& course : courses)
+        {
+            ht->insertInterned(course.id, course.name, prereqIds.data() + course.firstPrereq, course.prereqCount);
+        }
+        ht->finishRehash();
+        insertPhase.stop();
+        cout << "Successfully loaded " << courses.size() << " courses.\n";
+        return true;
+    }
+
+    // everything one chunk of a parallel load produced
+    struct ParsedChunk
+    {
+        string_view text;
+        vector<ParsedCourse> courses;
+        vector<string_view> prereqs;
+        StringArena unescaped; // quoted fields with "" in them
+        vector<vector<uint32_t>> shards; // course indexes per key shard, in line order
+        int lines = 0; // lines in the chunk, counted to the end even after an error
+        int lineOffset = 0; // lines in all earlier chunks
+        int errorLine = 0; // chunk local line of the first bad line, 0 if none
+        string error;
+    };
+
+    /**
+     * parseCoursesParallel
+     *
+     * The parse and validation of the parallel loaders, with the same checks and the same first
+     * error as loadCoursesMapped.
+     * 1. The file is cut into chunks at newlines outside quoted fields (the quotes before a newline
+     *    are counted in parallel, an odd count means it's inside one), and the chunks are parsed on
+     *    all cores. A chunk stops at its first bad record, its line count covers the whole chunk so
+     *    line numbers can be made global.
+     * 2. Each chunk buckets its courses by key hash into shards (shardOf(hashKey64) of shardCount),
+     *    and every shard checks duplicates on its own thread, walking its keys in file order.
+     *    That finds the earliest duplicate line.
+     * 3. Unknown prerequisites are looked up in the shard sets in parallel, and the first course
+     *    in file order that has one is reported.
+     * The earliest line error wins, like the serial loop that stops at the first bad line.
+     *
+     * @param data is the mapped file, chunks gets the parsed courses, shardCount and shardOf pick
+     * the key shards, totalCourses gets the course count.
+     * @return true if the file is valid, otherwise the first error was printed.
+     */
+    template <typename ShardFn>
+    bool parseCoursesParallel(string_view data, vector<ParsedChunk>& chunks, size_t shardCount, ShardFn shardOf, size_t& totalCourses)
+    {
+        size_t chunkCount = max<size_t>(1, min<size_t>(workerCount() * 4, data.size() / MIN_CHUNK_BYTES));
+
+        // quotes in each even slice, so the parity at every cut is known without a serial pass
+        size_t slice = data.size() / chunkCount;
+        vector<size_t> quotes(chunkCount, 0);
+        parallelFor(chunkCount, [&](size_t c)
+            {
+                size_t from = slice * c, to = (c + 1 == chunkCount) ? data.size() : slice * (c + 1);
+                quotes[c] = static_cast<size_t>(count(data.begin() + from, data.begin() + to, '"'));
+            });
+
+        // cut into chunks, each one ends just after a newline outside quotes (or at the end of the file)
+        chunks.clear();
+        chunks.resize(chunkCount);
+        size_t start = 0;
+        size_t quotesBefore = 0; // quotes before slice c
+        for (size_t c = 0; c < chunkCount; c++)
+        {
+            quotesBefore += quotes[c];
+            size_t end = (c + 1 == chunkCount) ? data.size() : max(start, slice * (c + 1));
+            if (end < data.size())
+            {
+                // a cut before start can't be used, its quotes have to be counted up to start
+                size_t at = slice * (c + 1);
+                size_t inside = quotesBefore;
+                if (at < end) inside += static_cast<size_t>(count(data.begin() + at, data.begin() + end, '"'));
+                while (end < data.size() && (data[end] != '\n' || inside % 2 != 0))
+                {
+                    if (data[end] == '"') inside++;
+                    end++;
+                }
+                end = min(data.size(), end + 1);
+            }
+            chunks[c].text = data.substr(start, end - start);
+            start = end;
+        }
+
+        // 1. parse every chunk
+        ScopedTimer parsePhase(Op::LoadParse);
+        parallelFor(chunkCount, [&](size_t c)
+            {
+                ParsedChunk& chunk = chunks[c];
+                chunk.courses.reserve(chunk.text.size() / 40 + 1);
+                chunk.shards.resize(shardCount);
+                string_view text = chunk.text;
+                // every line of the chunk, so the later chunks get the right line numbers after an error too
+                chunk.lines = static_cast<int>(count(text.begin(), text.end(), '\n')) + (!text.empty() && text.back() != '\n' ? 1 : 0);
+                vector<string_view> fields;
+                // only the file's first record can be a header
+                CsvReader reader(text, chunk.unescaped, c == 0);
+                while (reader.next(fields))
+                {
+                    ParsedCourse course;
+                    if (!parseCourseFields(fields.data(), fields.size(), chunk.prereqs, course, chunk.error))
+                    {
+                        chunk.errorLine = reader.line();
+                        break;
+                    }
+                    course.lineNumber = reader.line();
+                    chunk.shards[shardOf(hashKey64(course.courseNumber))].push_back(static_cast<uint32_t>(chunk.courses.size()));
+                    chunk.courses.push_back(course);
+                }
+                if (!reader.error().empty())
+                {
+                    chunk.errorLine = reader.line();
+                    chunk.error = reader.error();
+                }
+            });
+
+        int lineOffset = 0;
+        totalCourses = 0;
+        for (ParsedChunk& chunk : chunks)
+        {
+            chunk.lineOffset = lineOffset;
+            lineOffset += chunk.lines;
+            totalCourses += chunk.courses.size();
+        }
+
+        // earliest bad line so far
+        int firstErrorLine = INT_MAX;
+        string firstError;
+        for (const ParsedChunk& chunk : chunks)
+        {
+            if (chunk.errorLine != 0)
+            {
+                firstErrorLine = chunk.lineOffset + chunk.errorLine;
+                firstError = chunk.error;
+                break;
+            }
+        }
+
+        parsePhase.stop();
+
+        // 2. duplicates, one key set per shard
+        ScopedTimer validatePhase(Op::LoadValidate);
+        vector<unordered_set<CourseKey, CourseKeyHash>> shardKeys(shardCount); // long keys point into the file
+        vector<int> shardDuplicateLine(shardCount, INT_MAX);
+        vector<string_view> shardDuplicate(shardCount);
+        parallelFor(shardCount, [&](size_t s)
+            {
+                unordered_set<CourseKey, CourseKeyHash>& keys = shardKeys[s];
+                keys.reserve(totalCourses / shardCount + 1);
+                for (const ParsedChunk& chunk : chunks)
+                {
+                    for (uint32_t index : chunk.shards[s])
+                    {
+                        const ParsedCourse& course = chunk.courses[index];
+                        if (!keys.insert(CourseKey(course.courseNumber)).second)
+                        {
+                            // walking in file order, so the first repeat is this shard's earliest
+                            shardDuplicateLine[s] = chunk.lineOffset + course.lineNumber;
+                            shardDuplicate[s] = course.courseNumber;
+                            return;
+                        }
+                    }
+                }
+            });
+        for (size_t s = 0; s < shardCount; s++)
+        {
+            if (shardDuplicateLine[s] < firstErrorLine)
+            {
+                firstErrorLine = shardDuplicateLine[s];
+                firstError = "Duplicate course " + string(shardDuplicate[s]);
+            }
+        }
+        if (firstErrorLine != INT_MAX)
+        {
+            cout << "Error line " << firstErrorLine << ": " << firstError << endl;
+            return false;
+        }
+
+        // 3. unknown prerequisites, the first course in file order per chunk
+        vector<string> unknownError(chunkCount);
+        parallelFor(chunkCount, [&](size_t c)
+            {
+                const ParsedChunk& chunk = chunks[c];
+                for (const ParsedCourse& course : chunk.courses)
+                {
+                    for (size_t i = 0; i < course.prereqCount; i++)
+                    {
+                        string_view prereq = chunk.prereqs[course.firstPrereq + i];
+                        CourseKey key(prereq);
+                        if (shardKeys[shardOf(key.hash())].count(key) == 0)
+                        {
+                            unknownError[c] = "Error: Unknown prerequisite " + string(prereq) + " for course " + string(course.courseNumber);
+                            return;
+                        }
+                    }
+                }
+            });
+        for (const string& error : unknownError)
+        {
+            if (!error.empty())
+            {
+                cout << error << endl;
+                return false;
+            }
+        }
+
+        validatePhase.stop();
+        return true;
+    }
+
+    /**
+     * loadCoursesParallel
+     *
+     * Parallel version of loadCoursesMapped, see parseCoursesParallel. The courses then go into
+     * the table in file order.
+     *
+     * @param filePath the path to the CSV file to load, ht is a pointer to the hash table class.
+     * @return true if the whole file loaded.
+     */
+    bool loadCoursesParallel(const string& filePath, CourseHashTable* ht)
+    {
+        MappedFile file;
+        if (!file.open(filePath))
+        {
+            cout << "Error: Could not open file " << filePath << endl;
+            return false;
+        }
+
+        cout << "Loading courses from " << filePath << endl;
+        ht->Clear();
+
+        vector<ParsedChunk> chunks;
+        size_t totalCourses = 0;
+        size_t shardCount = workerCount();
+        if (!parseCoursesParallel(file.view(), chunks, shardCount, [shardCount](uint64_t h) { return h % shardCount; }, totalCourses))
+        {
+            return false;
+        }
+
+        // merge into the table in file order
+        ScopedTimer insertPhase(Op::LoadInsert);
+        ht->reserve(totalCourses);
+        for (const ParsedChunk& chunk : chunks)
+        {
+            for (const ParsedCourse& course : chunk.courses)
+            {
+                ht->insertFields(course.courseNumber, course.name, chunk.prereqs.data() + course.firstPrereq, course.prereqCount);
+            }
+        }
+        ht->finishRehash();
+        insertPhase.stop();
+        cout << "Successfully loaded " << totalCourses << " courses.\n";
+        return true;
+    }
+
+    /**
+     * loadCoursesSharded
+     *
+     * loadCoursesParallel into a ShardedCourseTable. The parse buckets courses by the table's own
+     * shards, so the insert runs a thread per shard (up to the core count), each one putting its
+     * shard's courses in, in file order, with no lock and nothing shared with the other threads.
+     *
+     * @param filePath the path to the CSV file to load, table to load into.
+     * @return true if the whole file loaded, otherwise the table is left empty.
+     */
+    bool loadCoursesSharded(const string& filePath, ShardedCourseTable* table)
+    {
+        MappedFile file;
+        if (!file.open(filePath))
+        {
+            cout << "Error: Could not open file " << filePath << endl;
+            return false;
+        }
+
+        cout << "Loading courses from " << filePath << endl;
+        table->Clear();
+
+        vector<ParsedChunk> chunks;
+        size_t totalCourses = 0;
+        if (!parseCoursesParallel(file.view(), chunks, table->shardCount(), [table](uint64_t h) { return table->shardOf(h); }, totalCourses))
+        {
+            return false;
+        }
+
+        ScopedTimer insertPhase(Op::LoadInsert);
+        parallelFor(table->shardCount(), [&](size_t s)
+            {
+                CourseHashTable& shard = table->shard(s);
+                size_t courses = 0;
+                for (const ParsedChunk& chunk : chunks) courses += chunk.shards[s].size();
+                shard.reserve(courses);
+                for (const ParsedChunk& chunk : chunks)
+                {
+                    for (uint32_t index : chunk.shards[s])
+                    {
+                        const ParsedCourse& course = chunk.courses[index];
+                        shard.insertFields(course.courseNumber, course.name, chunk.prereqs.data() + course.firstPrereq, course.prereqCount);
+                    }
+                }
+                shard.finishRehash();
+            });
+        insertPhase.stop();
+        cout << "Successfully loaded " << totalCourses << " courses.\n";
+        return true;
+    }
+
+    // bytes per read of the pipelined loader, a block grows if one record doesn't fit
+    constexpr size_t PIPELINE_BLOCK_BYTES = 1024 * 1024;
+    // the longest record the pipelined loader takes, past it an open quote is an error, not a reason to read on
+    constexpr size_t PIPELINE_RECORD_LIMIT = 16 * 1024 * 1024;
+    // blocks in flight: one being read, parsed and inserted each, the rest queued between them
+    constexpr size_t PIPELINE_BLOCKS = 8;
+
+    /**
+     * PipelineStats
+     *
+     * What a pipelined load (or validation) saw, and where its time went. Every stage's time is
+     * split into working and waiting on its neighbours, so the stage that hardly waits is the one
+     * holding the others up.
+     */
+    struct PipelineStats
+    {
+        struct Stage
+        {
+            double busySeconds = 0.0;
+            double waitSeconds = 0.0;
+        };
+        Stage read, parse, insert; // insert only checks and interns when validating
+        double seconds = 0.0;
+        uint64_t bytes = 0;
+        uint64_t lines = 0;
+        uint64_t courses = 0;
+        uint64_t prerequisites = 0;
+        size_t maxPrerequisites = 0;
+        size_t courseNumbers = 0; // distinct, prerequisites included
+        size_t blocks = 0;
+    };
+
+    // one read of the pipelined loader, whole records, and what the parse stage made of them
+    struct PipelineBlock
+    {
+        vector<char> bytes;
+        size_t size = 0; // bytes of records, anything after is the next block's start
+        int firstLine = 1; // file line of the first byte
+        bool first = false; // only the file's first block can start with a header
+        vector<ParsedCourse> courses;
+        vector<string_view> prereqs;
+        StringArena unescaped; // quoted fields with "" in them
+        string error; // the block's first bad record ends the load, the reader sets it for a record it can't cut
+        int errorLine = 0;
+    };
+
+    /**
+     * recordsEnd
+     *
+     * @param data that starts at a record, size of it.
+     * @return the offset just past its last newline outside quotes, 0 if there's none.
+     */
+    size_t recordsEnd(const char* data, size_t size)
+    {
+        // quotes before each position, walking back from the end
+        size_t quotes = static_cast<size_t>(count(data, data + size, '"'));
+        for (size_t i = size; i-- > 0;)
+        {
+            if (data[i] == '\n' && quotes % 2 == 0) return i + 1;
+            if (data[i] == '"') quotes--;
+        }
+        return 0;
+    }
+
+    /**
+     * loadCoursesPipelined
+     *
+     * Loads with the reading, parsing and inserting overlapped, on three threads connected by
+     * SpscQueues: the reader fills PIPELINE_BLOCKS blocks with large reads, cut after the last whole
+     * record (the rest starts the next block), the parser runs CsvReader over each block, and the
+     * calling thread interns, checks for duplicates and inserts, then hands the block back to the
+     * reader. A full queue stalls the stage feeding it, so at most PIPELINE_BLOCKS blocks are ever
+     * in memory, each at most PIPELINE_RECORD_LIMIT long. Unknown prerequisites are checked at the end, from the first reference to every
+     * course number. Same checks, messages and line numbers as loadCoursesMapped.
+     *
+     * Without a table it only validates: nothing is kept but the course numbers, so a catalog
+     * larger than memory streams through.
+     *
+     * @param filePath the path to the CSV file to load, ht is the table or nullptr to only validate,
+     * stats gets the counts and the time per stage if it's given.
+     * @return true if the whole file loaded (or is valid), otherwise the table is left empty.
+     */
+    bool loadCoursesPipelined(const string& filePath, CourseHashTable* ht, PipelineStats* stats = nullptr)
+    {
+        ifstream file(filePath, ios::binary);
+        if (!file.is_open())
+        {
+            cout << "Error: Could not open file " << filePath << endl;
+            return false;
+        }
+
+        bool validateOnly = ht == nullptr;
+        cout << (validateOnly ? "Validating courses in " : "Loading courses from ") << filePath << endl;
+        CourseIdTable ownIds; // course numbers when there's no table to intern them
+        if (!validateOnly)
+        {
+            ht->Clear();
+            // size the table once, guessing one course per 40 bytes of file
+            file.seekg(0, ios::end);
+            ht->reserve(static_cast<size_t>(max<streamoff>(0, file.tellg())) / 40 + 1);
+            file.seekg(0, ios::beg);
+        }
+        auto intern = [&](string_view courseNumber) { return validateOnly ? ownIds.intern(courseNumber) : ht->intern(courseNumber); };
+        auto idCount = [&]() { return validateOnly ? ownIds.size() : ht->idCount(); };
+
+        PipelineStats result;
+        auto start = chrono::steady_clock::now();
+        auto since = [](chrono::steady_clock::time_point from) { return chrono::duration<double>(chrono::steady_clock::now() - from).count(); };
+        vector<PipelineBlock> blocks(PIPELINE_BLOCKS);
+        SpscQueue<PipelineBlock*, PIPELINE_BLOCKS> freeBlocks, readBlocks, parsedBlocks;
+        for (PipelineBlock& block : blocks) freeBlocks.push(&block, result.read.waitSeconds);
+        auto cancel = [&]()
+            {
+                freeBlocks.cancel();
+                readBlocks.cancel();
+                parsedBlocks.cancel();
+            };
+
+        // 1. read whole records into free blocks
+        string readError;
+        thread reader([&]()
+            {
+                ScopedTimer readPhase(Op::LoadRead);
+                auto begin = chrono::steady_clock::now();
+                string carry; // the partial record at the end of the last block
+                int line = 1;
+                char last = '\n';
+                bool first = true, end = false;
+                PipelineBlock* block = nullptr;
+                while (!end && freeBlocks.pop(block, result.read.waitSeconds))
+                {
+                    vector<char>& bytes = block->bytes;
+                    // room for the carry and as much again, a block grown by a long record goes back to size
+                    size_t wanted = max(PIPELINE_BLOCK_BYTES, carry.size() * 2);
+                    if (bytes.size() > wanted && bytes.size() > PIPELINE_BLOCK_BYTES) vector<char>(wanted).swap(bytes);
+                    else if (bytes.size() < wanted) bytes.resize(wanted);
+                    memcpy(bytes.data(), carry.data(), carry.size());
+                    size_t filled = carry.size(), cut = 0;
+                    block->errorLine = 0;
+                    while (true)
+                    {
+                        // a record longer than the block, make room for the rest of it
+                        if (filled == bytes.size())
+                        {
+                            if (bytes.size() >= PIPELINE_RECORD_LIMIT)
+                            {
+                                // the block holds one record from line, the parser passes the error on in order
+                                bool openQuote = count(bytes.data(), bytes.data() + filled, '"') % 2 != 0;
+                                block->error = openQuote ? "Unterminated quoted field." : "Record longer than " + to_string(PIPELINE_RECORD_LIMIT >> 20) + " MB.";
+                                block->errorLine = line;
+                                break;
+                            }
+                            bytes.resize(min(bytes.size() * 2, PIPELINE_RECORD_LIMIT));
+                        }
+                        file.read(bytes.data() + filled, static_cast<streamsize>(bytes.size() - filled));
+                        filled += static_cast<size_t>(file.gcount());
+                        if (file.bad())
+                        {
+                            readError = "Error: Could not read file " + filePath;
+                            cancel();
+                            return;
+                        }
+                        if (!file)
+                        {
+                            // the end of the file ends the last record too
+                            end = true;
+                            cut = filled;
+                            break;
+                        }
+                        cut = recordsEnd(bytes.data(), filled);
+                        if (cut > 0) break;
+                    }
+                    if (block->errorLine != 0)
+                    {
+                        block->size = 0;
+                        result.lines = static_cast<uint64_t>(line - 1);
+                        if (readBlocks.push(block, result.read.waitSeconds)) readBlocks.close();
+                        return;
+                    }
+                    block->size = cut;
+                    block->firstLine = line;
+                    block->first = first;
+                    first = false;
+                    line += static_cast<int>(count(bytes.data(), bytes.data() + cut, '\n'));
+                    if (cut > 0) last = bytes[cut - 1];
+                    carry.assign(bytes.data() + cut, filled - cut);
+                    result.bytes += cut;
+                    result.blocks++;
+                    if (!readBlocks.push(block, result.read.waitSeconds)) return;
+                }
+                result.lines = static_cast<uint64_t>(line - 1) + (last != '\n' ? 1 : 0);
+                readBlocks.close();
+                result.read.busySeconds = since(begin) - result.read.waitSeconds;
+            });
+
+        // 2. parse each block, stopping at the first bad record
+        thread parser([&]()
+            {
+                ScopedTimer parsePhase(Op::LoadParse);
+                auto begin = chrono::steady_clock::now();
+                vector<string_view> fields;
+                PipelineBlock* block = nullptr;
+                while (readBlocks.pop(block, result.parse.waitSeconds))
+                {
+                    block->courses.clear();
+                    block->prereqs.clear();
+                    block->unescaped.Reset();
+                    // a record the reader couldn't cut, nothing to parse
+                    if (block->errorLine != 0)
+                    {
+                        parsedBlocks.push(block, result.parse.waitSeconds);
+                        break;
+                    }
+                    CsvReader csv(string_view(block->bytes.data(), block->size), block->unescaped, block->first);
+                    while (csv.next(fields))
+                    {
+                        ParsedCourse course;
+                        course.lineNumber = block->firstLine + csv.line() - 1;
+                        if (!parseCourseFields(fields.data(), fields.size(), block->prereqs, course, block->error))
+                        {
+                            block->errorLine = course.lineNumber;
+                            break;
+                        }
+                        block->courses.push_back(course);
+                    }
+                    if (!csv.error().empty())
+                    {
+                        block->errorLine = block->firstLine + csv.line() - 1;
+                        block->error = csv.error();
+                    }
+                    if (!parsedBlocks.push(block, result.parse.waitSeconds)) return;
+                    // nothing after the first error is looked at
+                    if (block->errorLine != 0) break;
+                }
+                parsedBlocks.close();
+                result.parse.busySeconds = since(begin) - result.parse.waitSeconds;
+            });
+
+        // 3. intern, check for duplicates and insert, in file order
+        ScopedTimer insertPhase(Op::LoadInsert);
+        auto insertStart = chrono::steady_clock::now();
+        vector<char> defined; // per id, set once a record defines that course
+        vector<uint64_t> firstReference; // per id, the first prerequisite naming it, in file order
+        vector<CourseId> referrer; // per id, the course with that first reference
+        vector<CourseId> prereqIds;
+        string error;
+        PipelineBlock* block = nullptr;
+        while (error.empty() && parsedBlocks.pop(block, result.insert.waitSeconds))
+        {
+            for (const ParsedCourse& course : block->courses)
+            {
+                CourseId id = intern(course.courseNumber);
+                prereqIds.clear();
+                for (size_t i = 0; i < course.prereqCount; i++) prereqIds.push_back(intern(block->prereqs[course.firstPrereq + i]));
+                if (defined.size() < idCount())
+                {
+                    size_t grown = max(idCount(), defined.size() * 2);
+                    defined.resize(grown, false);
+                    firstReference.resize(grown, UINT64_MAX);
+                    referrer.resize(grown, INVALID_COURSE_ID);
+                }
+                // check for duplicates
+                if (defined[id])
+                {
+                    error = "Error line " + to_string(course.lineNumber) + ": Duplicate course " + string(course.courseNumber);
+                    break;
+                }
+                defined[id] = true;
+                for (CourseId prereq : prereqIds)
+                {
+                    if (firstReference[prereq] == UINT64_MAX)
+                    {
+                        firstReference[prereq] = result.prerequisites;
+                        referrer[prereq] = id;
+                    }
+                    result.prerequisites++;
+                }
+                if (!validateOnly) ht->insertInterned(id, course.name, prereqIds.data(), prereqIds.size());
+                result.courses++;
+                result.maxPrerequisites = max(result.maxPrerequisites, prereqIds.size());
+            }
+            if (error.empty() && block->errorLine != 0) error = "Error line " + to_string(block->errorLine) + ": " + block->error;
+            if (error.empty() && !freeBlocks.push(block, result.insert.waitSeconds)) break;
+        }
+        // an error here leaves the other stages waiting on full or empty queues
+        if (!error.empty()) cancel();
+        reader.join();
+        parser.join();
+        result.insert.busySeconds = since(insertStart) - result.insert.waitSeconds;
+        insertPhase.stop();
+        if (error.empty()) error = readError;
+
+        // the first reference, in file order, to a course number no record defines
+        if (error.empty())
+        {
+            ScopedTimer validatePhase(Op::LoadValidate);
+            uint64_t firstUnknown = UINT64_MAX;
+            CourseId unknown = INVALID_COURSE_ID;
+            for (size_t id = 0; id < idCount(); id++)
+            {
+                if (!defined[id] && firstReference[id] < firstUnknown)
+                {
+                    firstUnknown = firstReference[id];
+                    unknown = static_cast<CourseId>(id);
+                }
+            }
+            if (unknown != INVALID_COURSE_ID)
+            {
+                auto numberOf = [&](CourseId id) { return string(validateOnly ? ownIds.courseNumber(id) : ht->courseNumberOf(id)); };
+                error = "Error: Unknown prerequisite " + numberOf(unknown) + " for course " + numberOf(referrer[unknown]);
+            }
+        }
+        result.courseNumbers = idCount();
+        result.seconds = since(start);
+        if (stats != nullptr) *stats = result;
+        if (!error.empty())
+        {
+            cout << error << endl;
+            if (!validateOnly) ht->Clear();
+            return false;
+        }
+
+        if (!validateOnly) ht->finishRehash();
+        cout << (validateOnly ? "Valid, " : "Successfully loaded ") << result.courses << " courses.\n";
+        cout << "Stages (ms working / waiting): read " << result.read.busySeconds * 1000.0 << " / " << result.read.waitSeconds * 1000.0
+            << ", parse " << result.parse.busySeconds * 1000.0 << " / " << result.parse.waitSeconds * 1000.0
+            << ", " << (validateOnly ? "check " : "insert ") << result.insert.busySeconds * 1000.0 << " / " << result.insert.waitSeconds * 1000.0 << "\n";
+        return true;
+    }
+
+    /**
+     * Load a CSV file containing course information into the hash table.
+     *
+     * @param filePath the path to the CSV file to load, ht is a pointer to the hash table class,
+     * mode picks the getline, the memory mapped, the parallel or the pipelined reader.
+     * @return true if the whole file loaded, otherwise the table is left empty.
+     */
+    bool loadCourses(const string& filePath, CourseHashTable* ht, LoadMode mode = LoadMode::Parallel)
+    {
+        if (mode == LoadMode::Pipelined) return loadCoursesPipelined(filePath, ht);
+        if (mode == LoadMode::Parallel) return loadCoursesParallel(filePath, ht);
+        if (mode == LoadMode::Mapped) return loadCoursesMapped(filePath, ht);
+        return loadCoursesStream(filePath, ht);
+    }
+
+    /**
+     * isSnapshotFile
+     *
+     * @return true if the file starts with the snapshot magic, whatever its extension.
+     */
+    bool isSnapshotFile(const string& filePath)
+    {
+        ifstream file(filePath, ios::binary);
+        char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+        return file.read(magic, sizeof(magic)) && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+    }
+
+    /**
+     * loadCatalog
+     *
+     * Loads a catalog file of either kind: a snapshot is mapped, anything else is parsed as CSV.
+     *
+     * @param filePath to load, ht is the table, verify checks a snapshot's body checksum, mode is the CSV reader.
+     * @return true if it loaded.
+     */
+    bool loadCatalog(const string& filePath, CourseHashTable* ht, bool verify = true, LoadMode mode = LoadMode::Parallel)
+    {
+        if (!isSnapshotFile(filePath)) return loadCourses(filePath, ht, mode);
+        cout << "Loading snapshot " << filePath << endl;
+        if (!ht->loadSnapshot(filePath, verify)) return false;
+        cout << "Successfully loaded " << ht->Size() << " courses.\n";
+        return true;
+    }
+
+    /**
+     * CatalogDelta
+     *
+     * Changes to a loaded catalog: courses to add or replace, parsed like loader lines (views into
+     * the change file), and course numbers to remove.
+     */
+    struct CatalogDelta
+    {
+        vector<ParsedCourse> upserts;
+        vector<string_view> prereqs; // of the upserts, see ParsedCourse::firstPrereq
+        vector<string_view> removals;
+        vector<int> removalLines; // line of each removal, 0 when it comes from a diff
+        size_t unchanged = 0; // rows of a full file that matched the loaded course
+    };
+
+    /**
+     * applyCatalogDelta
+     *
+     * Checks a delta against the table, then applies it. Only the changed courses are looked at:
+     * a course may only change once, a removed course has to be loaded, every prerequisite of an
+     * added or replaced course has to be loaded and not removed (or added by the delta), and no
+     * course that stays may still require a removed one. Nothing changes if a check fails.
+     *
+     * @param delta changes to apply, ht is the table.
+     * @return true if it was applied.
+     */
+    bool applyCatalogDelta(const CatalogDelta& delta, CourseHashTable* ht)
+    {
+        // per id, what the delta does to a loaded course number
+        vector<CourseId> removals;
+        vector<char> removed(ht->idCount(), false);
+        vector<char> replaced(ht->idCount(), false);
+        unordered_map<CourseKey, int, CourseKeyHash> changed; // course number, line
+        changed.reserve(delta.upserts.size() + delta.removals.size());
+        unordered_set<CourseKey, CourseKeyHash> upserted; // course numbers the delta adds or replaces
+        upserted.reserve(delta.upserts.size());
+        auto changeOnce = [&](string_view courseNumber, int lineNumber)
+            {
+                auto found = changed.emplace(CourseKey(courseNumber), lineNumber);
+                if (found.second) return true;
+                // the later of the two lines
+                cout << "Error line " << max(lineNumber, found.first->second) << ": Course " << courseNumber << " changed twice" << endl;
+                return false;
+            };
+        for (size_t i = 0; i < delta.removals.size(); i++)
+        {
+            if (!changeOnce(delta.removals[i], delta.removalLines[i])) return false;
+        }
+        for (const ParsedCourse& course : delta.upserts)
+        {
+            if (!changeOnce(course.courseNumber, course.lineNumber)) return false;
+            upserted.insert(CourseKey(course.courseNumber));
+            CourseId id = ht->idOf(course.courseNumber);
+            if (id != INVALID_COURSE_ID) replaced[id] = true;
+        }
+        for (size_t i = 0; i < delta.removals.size(); i++)
+        {
+            string_view courseNumber = delta.removals[i];
+            CourseId id = ht->idOf(courseNumber);
+            if (!ht->isCourse(id))
+            {
+                cout << "Error line " << delta.removalLines[i] << ": Unknown course " << courseNumber << endl;
+                return false;
+            }
+            removed[id] = true;
+            removals.push_back(id);
+        }
+
+        // prerequisites of the courses that change
+        for (const ParsedCourse& course : delta.upserts)
+        {
+            for (size_t i = 0; i < course.prereqCount; i++)
+            {
+                string_view prereq = delta.prereqs[course.firstPrereq + i];
+                CourseId id = ht->idOf(prereq);
+                bool loaded = ht->isCourse(id) && !removed[id];
+                if (!loaded && upserted.count(CourseKey(prereq)) == 0)
+                {
+                    cout << "Error: Unknown prerequisite " << prereq << " for course " << course.courseNumber << endl;
+                    return false;
+                }
+            }
+        }
+
+        // courses that stay as they are, and still require a removed one
+        if (!delta.removals.empty())
+        {
+            string error;
+            ht->forEachCourse([&](CourseId id, const CourseId* prereqs, size_t count)
+                {
+                    if (!error.empty() || removed[id] || replaced[id]) return;
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        if (prereqs[i] < removed.size() && removed[prereqs[i]])
+                        {
+                            error = "Error: Course " + string(ht->courseNumberOf(id)) + " still requires removed course "
+                                + string(ht->courseNumberOf(prereqs[i]));
+                            return;
+                        }
+                    }
+                });
+            if (!error.empty())
+            {
+                cout << error << endl;
+                return false;
+            }
+        }
+
+        size_t added = 0;
+        // by id, the first change of a snapshot moves its course numbers out of the mapping
+        for (CourseId id : removals) ht->Remove(ht->courseNumberOf(id));
+        for (const ParsedCourse& course : delta.upserts)
+        {
+            if (!ht->isCourse(ht->idOf(course.courseNumber))) added++;
+            ht->insertFields(course.courseNumber, course.name, delta.prereqs.data() + course.firstPrereq, course.prereqCount);
+        }
+        ht->finishRehash();
+        cout << "Applied " << delta.upserts.size() + delta.removals.size() << " changes: " << added << " added, "
+            << delta.upserts.size() - added << " replaced, " << delta.removals.size() << " removed";
+        if (delta.unchanged > 0) cout << ", " << delta.unchanged << " unchanged";
+        cout << ". " << ht->Size() << " courses.\n";
+        return true;
+    }
+
+    /**
+     * sameCourse
+     *
+     * @return true if a parsed line has the loaded course's name and prerequisites, in order.
+     */
+    bool sameCourse(const CourseHashTable& ht, const CourseView& loaded, const ParsedCourse& course, const vector<string_view>& prereqs)
+    {
+        if (loaded.name != course.name || loaded.prerequisiteCount != course.prereqCount) return false;
+        for (size_t i = 0; i < course.prereqCount; i++)
+        {
+            if (ht.courseNumberOf(loaded.prerequisiteIds[i]) != prereqs[course.firstPrereq + i]) return false;
+        }
+        return true;
+    }
+
+    /**
+     * applyCatalogChanges
+     *
+     * Updates a loaded catalog from a file without reloading it. Two kinds of file:
+     * a change file, where every record is "+," and a catalog record (add, or replace the course) or
+     * "-,COURSE" (remove it), or a full catalog, which is compared record by record with the loaded
+     * courses: lines that differ are replaced, courses missing from it are removed, the rest stays
+     * as it is. Either way only the changes are checked and applied, see applyCatalogDelta.
+     * The first record picks the kind, course numbers never are "+" or "-". Both are read with
+     * CsvReader, so quoted fields work the same as when loading.
+     *
+     * @param filePath of the change file or catalog, ht is the loaded table.
+     * @return true if the changes were applied, otherwise the table is unchanged.
+     */
+    bool applyCatalogChanges(const string& filePath, CourseHashTable* ht)
+    {
+        MappedFile file;
+        if (!file.open(filePath))
+        {
+            cout << "Error: Could not open file " << filePath << endl;
+            return false;
+        }
+        string_view data = file.view();
+        StringArena unescaped; // the delta keeps views into it
+        vector<string_view> fields;
+        CsvReader peek(data, unescaped, false);
+        bool changeFile = peek.next(fields) && (fields[0] == "+" || fields[0] == "-");
+        cout << "Applying " << (changeFile ? "changes" : "differences") << " from " << filePath << endl;
+
+        CatalogDelta delta;
+        vector<char> listed(ht->idCount(), false); // loaded courses the full file has
+        unordered_set<CourseKey, CourseKeyHash> added; // courses the full file adds
+        string error;
+        // a full catalog can start with a header row, a change file can't
+        CsvReader reader(data, unescaped, !changeFile);
+        while (reader.next(fields))
+        {
+            int lineNumber = reader.line();
+            const string_view* courseFields = fields.data();
+            size_t fieldCount = fields.size();
+            if (changeFile)
+            {
+                if (fields[0] == "-")
+                {
+                    if (fields.size() != 2 || fields[1].empty())
+                    {
+                        cout << "Error line " << lineNumber << ": A removal names one course number." << endl;
+                        return false;
+                    }
+                    delta.removals.push_back(fields[1]);
+                    delta.removalLines.push_back(lineNumber);
+                    continue;
+                }
+                if (fields[0] != "+")
+                {
+                    cout << "Error line " << lineNumber << ": Change lines start with + or -." << endl;
+                    return false;
+                }
+                courseFields++;
+                fieldCount--;
+            }
+
+            ParsedCourse course;
+            if (!parseCourseFields(courseFields, fieldCount, delta.prereqs, course, error))
+            {
+                cout << "Error line " << lineNumber << ": " << error << endl;
+                return false;
+            }
+            course.lineNumber = lineNumber;
+            if (!changeFile)
+            {
+                CourseId id = ht->idOf(course.courseNumber);
+                bool loaded = ht->isCourse(id);
+                if (loaded ? listed[id] : !added.insert(CourseKey(course.courseNumber)).second)
+                {
+                    cout << "Error line " << lineNumber << ": Duplicate course " << course.courseNumber << endl;
+                    return false;
+                }
+                if (loaded)
+                {
+                    listed[id] = true;
+                    if (sameCourse(*ht, ht->findCourse(course.courseNumber), course, delta.prereqs))
+                    {
+                        delta.prereqs.resize(course.firstPrereq);
+                        delta.unchanged++;
+                        continue;
+                    }
+                }
+            }
+            delta.upserts.push_back(course);
+        }
+        if (!reader.error().empty())
+        {
+            cout << "Error line " << reader.line() << ": " << reader.error() << endl;
+            return false;
+        }
+
+        // the loaded courses the full file no longer has
+        if (!changeFile)
+        {
+            ht->forEachCourse([&](CourseId id, const CourseId*, size_t)
+                {
+                    if (listed[id]) return;
+                    delta.removals.push_back(ht->courseNumberOf(id));
+                    delta.removalLines.push_back(0);
+                });
+        }
+        return applyCatalogDelta(delta, ht);
+    }
+
+    const pair<LoadMode, const char*> LOAD_MODES[] = { { LoadMode::Stream, "stream" }, { LoadMode::Mapped, "mapped" },
+        { LoadMode::Parallel, "parallel" }, { LoadMode::Pipelined, "pipelined" } };
+    const pair<StorageMode, const char*> STORAGE_MODES[] = { { StorageMode::Chained, "chained" }, { StorageMode::Flat, "flat" } };
+
+    /**
+     * fileBytes
+     *
+     * @return the size of the file, or -1 if it can't be opened.
+     */
+    long long fileBytes(const string& filePath)
+    {
+        ifstream file(filePath, ios::binary | ios::ate);
+        if (!file.is_open()) return -1;
+        return static_cast<long long>(file.tellg());
+    }
 
-        // open filePath for reading
-        ifstream file(filePath);
-        // if open fails
+    /**
+     * timeRuns
+     *
+     * Calls load until it has run minRuns times and for minSeconds, with the loader output silenced.
+     *
+     * @param load returns false when it fails, runs gets the number of calls.
+     * @return seconds per call, or -1 if a call failed.
+     */
+    template <typename LoadFn>
+    double timeRuns(LoadFn load, int minRuns, double minSeconds, int& runs)
+    {
+        NullBuffer nullBuffer;
+        bool loaded = true;
+        double seconds = 0.0;
+        runs = 0;
+        // the loaders print progress, silence it while timing
+        streambuf* original = cout.rdbuf(&nullBuffer);
+        while (loaded && (runs < minRuns || seconds < minSeconds))
+        {
+            auto start = chrono::steady_clock::now();
+            loaded = load();
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            runs++;
+        }
+        cout.rdbuf(original);
+        return loaded ? seconds / runs : -1.0;
+    }
+
+    /**
+     * timeLoad
+     *
+     * Loads the file into a scratch table until it has run minRuns times and for minSeconds,
+     * with the loader output silenced.
+     *
+     * @param filePath, storage and mode to load with, runs gets the number of loads.
+     * @return seconds per load, or -1 if the load failed.
+     */
+    double timeLoad(const string& filePath, StorageMode storage, LoadMode mode, int minRuns, double minSeconds, int& runs)
+    {
+        CourseHashTable table(storage);
+        return timeRuns([&]() { return loadCourses(filePath, &table, mode); }, minRuns, minSeconds, runs);
+    }
+
+    // timeLoad for loadCoursesSharded, with the default shard count
+    double timeShardedLoad(const string& filePath, StorageMode storage, int minRuns, double minSeconds, int& runs)
+    {
+        ShardedCourseTable table(0, storage);
+        return timeRuns([&]() { return loadCoursesSharded(filePath, &table); }, minRuns, minSeconds, runs);
+    }
+
+    /**
+     * benchmarkLoadPaths
+     *
+     * Loads the file with each LoadMode, and with the sharded loader, into a scratch table of each
+     * storage mode and reports MB/s.
+     * Every combination repeats until it has run at least 3 times and for half a second.
+     *
+     * @param filePath of the CSV to load.
+     */
+    void benchmarkLoadPaths(const string& filePath)
+    {
+        long long bytes = fileBytes(filePath);
+        if (bytes < 0)
+        {
+            cout << "Error: Could not open file " << filePath << endl;
+            return;
+        }
+        double megabytes = static_cast<double>(bytes) / 1e6;
+
+        cout << "\nLoad benchmark for " << filePath << " (" << megabytes << " MB, "
+            << workerCount() << " threads)\n";
+        // keep the instrumentation out of the measured time and out of the statistics
+        bool recording = metrics().enabled.exchange(false);
+        for (const auto& storage : STORAGE_MODES)
+        {
+            for (const auto& load : LOAD_MODES)
+            {
+                int runs = 0;
+                double perRun = timeLoad(filePath, storage.first, load.first, 3, 0.5, runs);
+                if (perRun < 0)
+                {
+                    cout << "  " << storage.second << "/" << load.second << ": load failed\n";
+                    continue;
+                }
+                cout << "  " << storage.second << "/" << load.second << ": " << perRun * 1000.0 << " ms, "
+                    << megabytes / perRun << " MB/s (" << runs << " runs)\n";
+            }
+            int runs = 0;
+            double perRun = timeShardedLoad(filePath, storage.first, 3, 0.5, runs);
+            if (perRun < 0) cout << "  " << storage.second << "/sharded: load failed\n";
+            else cout << "  " << storage.second << "/sharded: " << perRun * 1000.0 << " ms, " << megabytes / perRun << " MB/s (" << runs << " runs)\n";
+        }
+        metrics().enabled = recording;
+    }
+
+    /**
+     * benchmarkLookups
+     *
+     * Looks up every loaded course plus as many misses, in shuffled order, with searchCourse
+     * (copy), findCourse (view) and findMany (batched), and reports ns per lookup.
+     *
+     * @param table to query, it has to be loaded.
+     */
+    void benchmarkLookups(const CourseHashTable& table)
+    {
+        // the keys are copied out so they don't alias the table, half of them are misses
+        vector<string> keys;
+        keys.reserve(table.Size() * 2);
+        table.forEachCourse([&](CourseId id, const CourseId*, size_t)
+            {
+                keys.emplace_back(table.courseNumberOf(id));
+                keys.push_back(keys.back() + "#");
+            });
+        uint64_t seed = 88172645463325252ULL;
+        for (size_t i = keys.size(); i > 1; i--)
+        {
+            // xorshift, good enough for a shuffle
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            swap(keys[i - 1], keys[seed % i]);
+        }
+        vector<string_view> views(keys.begin(), keys.end());
+        vector<CourseView> results(keys.size());
+
+        cout << "\nLookup benchmark, " << keys.size() << " keys (half misses)\n";
+        bool recording = metrics().enabled.exchange(false);
+        size_t found = 0;
+        auto report = [&](const char* label, double seconds)
+            {
+                cout << "  " << label << ": " << seconds * 1e9 / keys.size() << " ns/lookup (" << found << " found)\n";
+                found = 0;
+            };
+
+        auto start = chrono::steady_clock::now();
+        for (const string& key : keys)
+        {
+            if (!table.searchCourse(key).courseNumber.empty()) found++;
+        }
+        report("searchCourse (copy)", chrono::duration<double>(chrono::steady_clock::now() - start).count());
+
+        start = chrono::steady_clock::now();
+        for (string_view key : views)
+        {
+            if (table.findCourse(key)) found++;
+        }
+        report("findCourse (view)", chrono::duration<double>(chrono::steady_clock::now() - start).count());
+
+        start = chrono::steady_clock::now();
+        table.findMany(views.data(), views.size(), results.data());
+        for (const CourseView& result : results)
+        {
+            if (result) found++;
+        }
+        report("findMany (batched)", chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        metrics().enabled = recording;
+    }
+
+    /**
+     * PolicyResult
+     *
+     * One row of compareHashPolicies.
+     */
+    struct PolicyResult
+    {
+        const char* name;
+        double loadMs = -1.0; // -1 if the load failed
+        uint64_t resizes = 0;
+        HashStats stats;
+        double lookupNs = 0.0; // findCourse per hit, shuffled order
+    };
+
+    /**
+     * compareHashPolicies
+     *
+     * Loads the file into a chained table with the polynomial hash, the word hash and the seeded
+     * word hash, and reports the load time, resizes, collisions against a random hash and the
+     * lookup cost of each.
+     *
+     * @param filePath of the CSV to load.
+     * @return a row per policy.
+     */
+    vector<PolicyResult> compareHashPolicies(const string& filePath)
+    {
+        struct Candidate { const char* name; HashPolicy policy; uint64_t seed; };
+        static const Candidate CANDIDATES[] = { { "polynomial", HashPolicy::Polynomial, 0 },
+            { "word", HashPolicy::Word, 0 }, { "word seeded", HashPolicy::Word, 0x5EEDULL } };
+        vector<PolicyResult> results;
+        bool recording = metrics().enabled.exchange(false);
+        NullBuffer nullBuffer;
+        for (const Candidate& candidate : CANDIDATES)
+        {
+            PolicyResult result;
+            result.name = candidate.name;
+            CourseHashTable table(StorageMode::Chained, candidate.policy, candidate.seed);
+            uint64_t resizesBefore = metrics().resizes.load();
+            streambuf* original = cout.rdbuf(&nullBuffer);
+            auto start = chrono::steady_clock::now();
+            bool loaded = loadCourses(filePath, &table, LoadMode::Mapped);
+            double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cout.rdbuf(original);
+            if (loaded)
+            {
+                result.loadMs = millis;
+                result.resizes = metrics().resizes.load() - resizesBefore;
+                result.stats = table.hashStatistics();
+
+                vector<string> keys;
+                table.forEachCourse([&](CourseId id, const CourseId*, size_t) { keys.emplace_back(table.courseNumberOf(id)); });
+                uint64_t seed = 88172645463325252ULL;
+                for (size_t i = keys.size(); i > 1; i--)
+                {
+                    seed ^= seed << 13;
+                    seed ^= seed >> 7;
+                    seed ^= seed << 17;
+                    swap(keys[i - 1], keys[seed % i]);
+                }
+                start = chrono::steady_clock::now();
+                for (const string& key : keys) table.findCourse(key);
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                result.lookupNs = keys.empty() ? 0.0 : seconds * 1e9 / keys.size();
+            }
+            results.push_back(result);
+        }
+        metrics().enabled = recording;
+        return results;
+    }
+
+    /**
+     * displayChain
+     *
+     * Prints a list of course ids sorted by course number, used for the full prerequisite chain.
+     * @param label to print first, ids to list, table to get the course numbers from.
+     */
+    void displayChain(const string& label, vector<CourseId> ids, const CourseHashTable& table)
+    {
+        sort(ids.begin(), ids.end(), [&](CourseId a, CourseId b)
+            {
+                return table.courseNumberOf(a) < table.courseNumberOf(b);
+            });
+        cout << label << " (" << ids.size() << "): ";
+        if (ids.empty()) cout << "none";
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            cout << table.courseNumberOf(ids[i]);
+            if (i < ids.size() - 1) cout << ", ";
+        }
+        cout << endl;
+    }
+
+    /**
+     * ReportFilter
+     *
+     * What a course report keeps, the defaults keep every course.
+     */
+    struct ReportFilter
+    {
+        string prefix;
+        uint32_t minPrerequisites = 0;
+        uint32_t maxPrerequisites = UINT32_MAX;
+        int level = -1; // first digit of the course number, -1 for any
+    };
+
+    /**
+     * printReport
+     *
+     * Filters the columns and prints the count, prerequisite totals, counts per level and per
+     * department, and the first matching courses.
+     *
+     * @param out stream to print to, columns of the catalog, filter of the courses to report on.
+     */
+    void printReport(ostream& out, const CourseColumns& columns, const ReportFilter& filter)
+    {
+        auto start = chrono::steady_clock::now();
+        CourseColumns::RowMask mask = columns.allRows();
+        if (!filter.prefix.empty()) columns.keepPrefix(mask, filter.prefix);
+        if (filter.minPrerequisites > 0 || filter.maxPrerequisites < UINT32_MAX)
+        {
+            columns.keepPrerequisites(mask, filter.minPrerequisites, filter.maxPrerequisites);
+        }
+        if (filter.level >= 0) columns.keepLevel(mask, static_cast<uint8_t>(filter.level));
+        size_t matched = columns.count(mask);
+        uint64_t prerequisites = columns.sumPrerequisites(mask);
+        uint32_t most = columns.maxPrerequisites(mask);
+        vector<size_t> levels = columns.countByLevel(mask);
+        vector<size_t> departments = columns.countByDepartment(mask);
+        vector<uint32_t> rows;
+        columns.selectRows(mask, rows);
+        double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        out << "Matching courses: " << matched << " of " << columns.size() << " (" << millis << " ms)\n";
+        if (matched == 0) return;
+        out << "Prerequisites: " << prerequisites << " total, " << fixed << setprecision(2)
+            << static_cast<double>(prerequisites) / matched << " per course, " << most << " at most\n";
+        out.unsetf(ios::fixed);
+        out << "By level (first digit):";
+        const char* separator = " ";
+        for (size_t level = 0; level < levels.size(); level++)
+        {
+            if (levels[level] == 0) continue;
+            out << separator;
+            if (level == CourseColumns::NO_LEVEL) out << "none: " << levels[level];
+            else out << level << ": " << levels[level];
+            separator = ", ";
+        }
+        out << "\nBy department:";
+        separator = " ";
+        size_t shown = 0, hidden = 0;
+        for (size_t d = 0; d < departments.size(); d++)
+        {
+            if (departments[d] == 0) continue;
+            if (shown++ < LIST_PAGE_SIZE)
+            {
+                out << separator << (columns.departmentName(d).empty() ? "(none)" : columns.departmentName(d)) << ": " << departments[d];
+                separator = ", ";
+            }
+            else hidden++;
+        }
+        if (hidden > 0) out << " and " << hidden << " more";
+        out << "\n";
+        for (size_t i = 0; i < rows.size() && i < LIST_PAGE_SIZE; i++)
+        {
+            out << columns.courseNumber(rows[i]) << ", " << columns.name(rows[i]) << "\n";
+        }
+        if (rows.size() > LIST_PAGE_SIZE) out << "... " << rows.size() - LIST_PAGE_SIZE << " more" << "\n";
+    }
+
+    /**
+     * writeJson
+     *
+     * Writes a histogram as a JSON object: count, mean, p50, p90, p99 and max.
+     */
+    void writeJson(ostream& out, const Histogram& h)
+    {
+        out << "{\"count\": " << h.count() << ", \"mean\": " << h.mean() << ", \"p50\": " << h.percentile(0.50)
+            << ", \"p90\": " << h.percentile(0.90) << ", \"p99\": " << h.percentile(0.99)
+            << ", \"max\": " << h.max() << "}";
+    }
+
+    /**
+     * jsonString
+     *
+     * Quotes and escapes text for JSON output.
+     */
+    string jsonString(string_view text)
+    {
+        string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\') quoted += '\\';
+            if (static_cast<unsigned char>(c) < 0x20) quoted += ' ';
+            else quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    /**
+     * printStatistics
+     *
+     * Dumps the instrumentation: latency per operation in ns, probes per lookup, the counters and
+     * the table's chain length (or flat probe distance) distribution.
+     *
+     * @param out stream to write to, table to describe, json for JSON instead of a text table.
+     */
+    void printStatistics(ostream& out, const CourseHashTable& table, bool json)
+    {
+        Metrics& m = metrics();
+        vector<size_t> chains = table.chainLengths();
+        // a snapshot's index is probed like flat storage
+        bool probed = table.Mode() != StorageMode::Chained;
+        const char* storageName = table.Mode() == StorageMode::Snapshot ? "snapshot" : (probed ? "flat" : "chained");
+        const char* chainLabel = table.Mode() == StorageMode::Snapshot ? "Course numbers by probe distance"
+            : (probed ? "Courses by probe distance" : "Buckets by chain length");
+        HashStats hashing = table.hashStatistics();
+        ViewCacheStats views = table.viewCacheStatistics();
+        const char* hashName = probed || table.Policy() == HashPolicy::Word ? "word" : "polynomial";
+
+        if (json)
+        {
+            auto histogram = [&](const Histogram& h) { writeJson(out, h); };
+            out << "{\n  \"latency_ns\": {";
+            for (size_t i = 0; i < static_cast<size_t>(Op::Count); i++)
+            {
+                out << (i == 0 ? "\n" : ",\n") << "    \"" << OP_NAMES[i] << "\": ";
+                histogram(m.latency[i]);
+            }
+            out << "\n  },\n  \"probes_per_lookup\": ";
+            histogram(m.probes);
+            out << ",\n  \"resizes\": " << m.resizes.load() << ",\n  \"rehashed_bytes\": " << m.rehashedBytes.load()
+                << ",\n  \"bytes_allocated\": " << m.bytesAllocated.load()
+                << ",\n  \"table\": {\"storage\": \"" << storageName
+                << "\", \"courses\": " << table.Size() << ", \"buckets\": " << table.bucketCount()
+                << ", \"max_load_factor\": " << table.MaxLoadFactor()
+                << ", \"arena_bytes\": " << table.arenaBytes() << ", \"memory_bytes\": " << table.memoryBytes() << ", \"" << (probed ? "probe_distance" : "chain_length") << "\": [";
+            for (size_t i = 0; i < chains.size(); i++) out << (i == 0 ? "" : ", ") << chains[i];
+            out << "]},\n  \"hash\": {\"policy\": \"" << hashName << "\", \"seed\": " << table.Seed() << ", \"keys\": " << hashing.keys
+                << ", \"homes\": " << hashing.homes << ", \"collisions\": " << hashing.collisions
+                << ", \"random_collisions\": " << hashing.randomCollisions << ", \"longest\": " << hashing.longest
+                << ", \"mean_probes\": " << hashing.meanProbes << "},\n  \"view_cache\": {\"hits\": " << views.hits
+                << ", \"misses\": " << views.misses << ", \"hit_rate\": " << views.hitRate() << ", \"entries\": " << views.entries
+                << ", \"capacity\": " << views.capacity << ", \"bytes\": " << views.bytes << ", \"invalidations\": " << views.invalidations
+                << ", \"evictions\": " << views.evictions << "}\n}\n";
+            return;
+        }
+
+        out << "\nOperation               count        mean         p50         p90         p99         max  (ns)\n";
+        auto row = [&](const char* name, const Histogram& h)
+            {
+                out << "  " << left << setw(20) << name << right << setw(8) << h.count() << fixed << setprecision(0)
+                    << setw(12) << h.mean() << setw(12) << h.percentile(0.50) << setw(12) << h.percentile(0.90)
+                    << setw(12) << h.percentile(0.99) << setw(12) << h.max() << "\n";
+                out.unsetf(ios::floatfield);
+                out << setprecision(6);
+            };
+        for (size_t i = 0; i < static_cast<size_t>(Op::Count); i++)
+        {
+            if (m.latency[i].count() > 0) row(OP_NAMES[i], m.latency[i]);
+        }
+        out << "\n";
+        row("probes/lookup", m.probes);
+        out << "\nResizes: " << m.resizes.load() << ", " << m.rehashedBytes.load() << " bytes rehashed\n";
+        out << "Bytes allocated: " << m.bytesAllocated.load() << "\n";
+        out << "Table: " << storageName << ", " << table.Size() << " courses, "
+            << table.bucketCount() << (probed ? " slots, " : " buckets, ") << "load factor "
+            << static_cast<double>(table.Size()) / max<size_t>(1, table.bucketCount()) << " (grows past " << table.MaxLoadFactor() << "), "
+            << table.arenaBytes() << " arena bytes\n";
+        out << "Memory: " << table.memoryBytes() << " bytes, " << table.memoryBytes() / max<size_t>(1, table.Size()) << " per course\n";
+        out << "Hash: " << hashName;
+        if (probed || table.Policy() == HashPolicy::Word) out << " (seed " << table.Seed() << ")";
+        out << ", " << hashing.collisions << " collisions over "
+            << hashing.keys << " keys (random hash: " << fixed << setprecision(1) << hashing.randomCollisions << "), longest "
+            << (probed ? "probe " : "chain ") << hashing.longest << ", " << setprecision(2) << hashing.meanProbes << " probes per hit\n";
+        out << "View cache: " << views.hits << " hits, " << views.misses << " misses (" << setprecision(1) << views.hitRate() * 100.0
+            << "% hit rate), " << views.entries << " of " << views.capacity << " views, " << views.bytes << " bytes, "
+            << views.invalidations << " invalidated, " << views.evictions << " evicted\n";
+        out.unsetf(ios::floatfield);
+        out << setprecision(6);
+        out << chainLabel << ":\n";
+        for (size_t i = 0; i < chains.size(); i++)
+        {
+            if (chains[i] > 0) out << "  " << setw(4) << i << ": " << chains[i] << "\n";
+        }
+    }
+
+    // knobs for generateCatalog
+    struct CatalogOptions
+    {
+        size_t courses = 100000;
+        double fanIn = 2.0; // mean prerequisites per course
+        double skew = 1.0; // zipf exponent over the departments, 0 spreads courses evenly
+        size_t nameLength = 24; // characters per course name
+        size_t departments = 40;
+        uint64_t seed = 42;
+    };
+
+    constexpr size_t MAX_GENERATED_COURSES = 10000000;
+    constexpr size_t MAX_DEPARTMENTS = 16 + 26 * 26 * 26;
+
+    /**
+     * SplitMix
+     *
+     * splitmix64 generator. The std distributions differ between standard libraries,
+     * this gives the same catalog for a seed on every platform.
+     */
+    class SplitMix
+    {
+    public:
+        explicit SplitMix(uint64_t seed) : state(seed) {}
+
+        uint64_t next()
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+        // uniform in [0, 1)
+        double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+        // uniform in [0, n), n > 0
+        size_t below(size_t n) { return static_cast<size_t>(uniform() * n); }
+
+    private:
+        uint64_t state;
+    };
+
+    /**
+     * departmentPrefix
+     *
+     * Real looking prefixes for the first departments, then 4 letter codes from QAAA up.
+     */
+    string departmentPrefix(size_t index)
+    {
+        static const char* const NAMES[] = { "CSCI", "MATH", "PHYS", "CHEM", "BIOL", "ENGL", "HIST", "ECON",
+            "PSYC", "PHIL", "ARTS", "MUSC", "STAT", "GEOL", "ASTR", "LING" };
+        if (index < 16) return NAMES[index];
+        string prefix = "QAAA";
+        size_t code = index - 16;
+        for (int i = 3; i >= 1; i--)
+        {
+            prefix[i] = static_cast<char>('A' + code % 26);
+            code /= 26;
+        }
+        return prefix;
+    }
+
+    /**
+     * generateCatalog
+     *
+     * Writes a synthetic catalog in the loader's CSV format. Departments are picked with a zipf
+     * distribution (skew is the exponent), courses are numbered from 100 up within a department.
+     * Each course gets 0 to 2 * fanIn prerequisites, mostly earlier courses in its own department,
+     * always earlier courses, so the catalog is acyclic and loads without errors.
+     *
+     * @param filePath to write, options for the shape of the catalog.
+     * @return false if the file can't be written.
+     */
+    bool generateCatalog(const string& filePath, const CatalogOptions& options)
+    {
+        static const char* const WORDS[] = { "Introduction", "to", "Advanced", "Topics", "in", "Data", "Structures",
+            "Algorithms", "Systems", "Theory", "Applied", "Methods", "Analysis", "Design", "Computing", "Networks",
+            "Modern", "Principles", "Foundations", "Seminar" };
+        const size_t wordCount = sizeof(WORDS) / sizeof(WORDS[0]);
+
+        ofstream file(filePath, ios::binary);
         if (!file.is_open())
         {
             cout << "Error: Could not open file " << filePath << endl;
             return false;
         }
 
-        // print "Loading file path " + filePath
-        cout << "Loading courses from " << filePath << endl;
-        // start clean, clear existing data if there is any.
-        ht->Clear();
-
-        // read and parse lines and build course objects
-        // for each line in file
-        string line;
-        while (getline(file, line))
+        SplitMix rng(options.seed);
+        vector<string> prefixes(options.departments);
+        vector<double> cumulative(options.departments);
+        double totalWeight = 0.0;
+        for (size_t d = 0; d < options.departments; d++)
+        {
+            prefixes[d] = departmentPrefix(d);
+            totalWeight += 1.0 / pow(static_cast<double>(d + 1), options.skew);
+            cumulative[d] = totalWeight;
+        }
+
+        // course numbers are kept as (department, number) and formatted when written
+        vector<uint32_t> departmentOf(options.courses);
+        vector<uint32_t> numberOf(options.courses);
+        vector<uint32_t> departmentSize(options.departments, 0);
+        vector<vector<uint32_t>> departmentCourses(options.departments);
+        vector<uint32_t> picks;
+        string buffer;
+        buffer.reserve(OUTPUT_FLUSH_BYTES + 4096);
+
+        auto appendCourseNumber = [&](uint32_t course)
+            {
+                char digits[16];
+                buffer.append(prefixes[departmentOf[course]]);
+                buffer.append(digits, to_chars(digits, digits + sizeof(digits), numberOf[course]).ptr);
+            };
+
+        for (size_t c = 0; c < options.courses; c++)
+        {
+            size_t department = lower_bound(cumulative.begin(), cumulative.end(), rng.uniform() * totalWeight) - cumulative.begin();
+            department = min(department, options.departments - 1);
+            departmentOf[c] = static_cast<uint32_t>(department);
+            numberOf[c] = 100 + departmentSize[department]++;
+            appendCourseNumber(static_cast<uint32_t>(c));
+            buffer += ',';
+
+            // whole words until the name is long enough, then cut to the exact length
+            size_t nameStart = buffer.size();
+            while (buffer.size() - nameStart < options.nameLength)
+            {
+                if (buffer.size() > nameStart) buffer += ' ';
+                buffer.append(WORDS[rng.below(wordCount)]);
+            }
+            buffer.resize(nameStart + options.nameLength);
+            while (buffer.back() == ' ') buffer.pop_back();
+
+            // 0 to 2 * fanIn distinct earlier courses, 70% from the same department
+            size_t wanted = min(c, static_cast<size_t>(rng.uniform() * (2.0 * options.fanIn + 1.0)));
+            const vector<uint32_t>& sameDepartment = departmentCourses[department];
+            picks.clear();
+            for (size_t attempt = 0; picks.size() < wanted && attempt < wanted * 4; attempt++)
+            {
+                uint32_t pick = (!sameDepartment.empty() && rng.uniform() < 0.7)
+                    ? sameDepartment[rng.below(sameDepartment.size())]
+                    : static_cast<uint32_t>(rng.below(c));
+                if (find(picks.begin(), picks.end(), pick) == picks.end()) picks.push_back(pick);
+            }
+            for (uint32_t pick : picks)
+            {
+                buffer += ',';
+                appendCourseNumber(pick);
+            }
+            buffer += '\n';
+            departmentCourses[department].push_back(static_cast<uint32_t>(c));
+
+            if (buffer.size() >= OUTPUT_FLUSH_BYTES)
+            {
+                file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+        file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        return static_cast<bool>(file);
+    }
+
+    /**
+     * peakRssKilobytes
+     *
+     * @return the process's peak resident set size in KB, 0 if the platform won't say.
+     */
+    size_t peakRssKilobytes()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.PeakWorkingSetSize / 1024;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss) / 1024; // bytes on macOS
+#else
+        return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+    }
+
+    /**
+     * runBenchSuite
+     *
+     * The reproducible benchmark: loadCourses throughput for every storage and load mode, then per
+     * storage mode Insert time as the table grows (ns per insert between powers of two) and into a
+     * reserve()d table, with the resizes and rehashed bytes of each, hit and
+     * miss searchCourse latency, printAll time, title search latency, snapshots, reader and sharded
+     * insert scaling, the hash policies side by side, and the peak RSS of the whole run. Results are one
+     * JSON document, progress goes to stderr. Instrumentation is off while it runs.
+     *
+     * @param filePath catalog to run on, generated has the generator options if it's synthetic,
+     * searches is the number of hit (and of miss) lookups, json gets the results.
+     * @return false if the catalog doesn't load.
+     */
+    bool runBenchSuite(const string& filePath, const CatalogOptions* generated, size_t searches, ostream& json)
+    {
+        constexpr size_t GROWTH_BATCH = 65536; // courses built ahead of each timed Insert run
+        constexpr size_t TITLE_QUERIES = 2000;
+        constexpr double READ_SECONDS = 0.5; // per reader scaling run
+
+        long long bytes = fileBytes(filePath);
+        if (bytes < 0)
+        {
+            cerr << "Error: Could not open file " << filePath << endl;
+            return false;
+        }
+        bool recording = metrics().enabled.exchange(false);
+        NullBuffer nullBuffer;
+        ostream nullStream(&nullBuffer);
+
+        json << "{\n  \"commit\": " << jsonString(BUILD_COMMIT) << ",\n  \"threads\": " << workerCount()
+            << ",\n  \"catalog\": {\"path\": " << jsonString(filePath) << ", \"bytes\": " << bytes;
+        if (generated != nullptr)
+        {
+            json << ", \"generated\": {\"courses\": " << generated->courses << ", \"fan_in\": " << generated->fanIn
+                << ", \"skew\": " << generated->skew << ", \"name_length\": " << generated->nameLength
+                << ", \"departments\": " << generated->departments << ", \"seed\": " << generated->seed << "}";
+        }
+        json << "},\n  \"load\": [";
+
+        // 1. loadCourses, once for small files is too noisy so repeat up to a second
+        bool first = true;
+        for (const auto& storage : STORAGE_MODES)
+        {
+            for (const auto& load : LOAD_MODES)
+            {
+                cerr << "load " << storage.second << "/" << load.second << endl;
+                int runs = 0;
+                double perRun = timeLoad(filePath, storage.first, load.first, 1, 1.0, runs);
+                if (perRun < 0)
+                {
+                    cerr << "Error: " << filePath << " doesn't load, run it through --load for the message" << endl;
+                    metrics().enabled = recording;
+                    return false;
+                }
+                json << (first ? "\n" : ",\n") << "    {\"storage\": \"" << storage.second << "\", \"mode\": \"" << load.second
+                    << "\", \"runs\": " << runs << ", \"ms\": " << perRun * 1000.0
+                    << ", \"mb_per_s\": " << static_cast<double>(bytes) / 1e6 / perRun << "}";
+                first = false;
+            }
+            cerr << "load " << storage.second << "/sharded" << endl;
+            int runs = 0;
+            double perRun = timeShardedLoad(filePath, storage.first, 1, 1.0, runs);
+            json << ",\n    {\"storage\": \"" << storage.second << "\", \"mode\": \"sharded\", \"runs\": " << runs
+                << ", \"ms\": " << perRun * 1000.0 << ", \"mb_per_s\": " << static_cast<double>(bytes) / 1e6 / perRun << "}";
+        }
+        json << "\n  ],\n  \"storage\": [";
+
+        first = true;
+        for (const auto& storage : STORAGE_MODES)
+        {
+            CourseHashTable source(storage.first);
+            streambuf* original = cout.rdbuf(&nullBuffer);
+            loadCourses(filePath, &source, LoadMode::Mapped);
+            cout.rdbuf(original);
+            vector<CourseId> ids;
+            ids.reserve(source.Size());
+            source.forEachCourse([&](CourseId id, const CourseId*, size_t) { ids.push_back(id); });
+
+            // 2. Insert under growth, Course objects are built outside the timed part
+            cerr << "insert " << storage.second << endl;
+            json << (first ? "\n" : ",\n") << "    {\"storage\": \"" << storage.second << "\", \"courses\": " << ids.size()
+                << ", \"memory_bytes\": " << source.memoryBytes()
+                << ", \"bytes_per_course\": " << static_cast<double>(source.memoryBytes()) / max<size_t>(1, ids.size())
+                << ",\n     \"insert_growth\": [";
+            first = false;
+            // the second pass inserts the same courses into a table that was reserve()d for all of them
+            for (int presized = 0; presized < 2; presized++)
+            {
+                CourseHashTable grown(storage.first);
+                if (presized == 1) grown.reserve(ids.size());
+                vector<Course> batch;
+                size_t inserted = 0;
+                size_t segmentStart = 0;
+                size_t boundary = 1024;
+                double segmentSeconds = 0.0;
+                double totalSeconds = 0.0;
+                uint64_t resizesBefore = metrics().resizes.load();
+                uint64_t rehashedBefore = metrics().rehashedBytes.load();
+                original = cout.rdbuf(&nullBuffer); // resize messages
+                while (inserted < ids.size())
+                {
+                    size_t end = min({ ids.size(), boundary, inserted + GROWTH_BATCH });
+                    batch.clear();
+                    for (size_t i = inserted; i < end; i++)
+                    {
+                        CourseView view = source.findCourse(source.courseNumberOf(ids[i]));
+                        Course course;
+                        course.courseNumber = string(view.courseNumber);
+                        course.name = string(view.name);
+                        for (size_t p = 0; p < view.prerequisiteCount; p++)
+                        {
+                            course.prerequisites.emplace_back(source.courseNumberOf(view.prerequisiteIds[p]));
+                        }
+                        batch.push_back(move(course));
+                    }
+                    auto start = chrono::steady_clock::now();
+                    for (const Course& course : batch) grown.Insert(course);
+                    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                    segmentSeconds += seconds;
+                    totalSeconds += seconds;
+                    inserted = end;
+                    if (presized == 0 && (inserted == boundary || inserted == ids.size()))
+                    {
+                        json << (segmentStart == 0 ? "" : ", ") << "{\"size\": " << inserted << ", \"ns_per_insert\": "
+                            << segmentSeconds * 1e9 / (inserted - segmentStart) << "}";
+                        segmentStart = inserted;
+                        segmentSeconds = 0.0;
+                    }
+                    if (inserted == boundary) boundary *= 2;
+                }
+                cout.rdbuf(original);
+                const char* prefix = presized == 1 ? "reserved_" : "";
+                if (presized == 0) json << "]";
+                json << ",\n     \"" << prefix << "insert_ns\": " << (ids.empty() ? 0.0 : totalSeconds * 1e9 / ids.size())
+                    << ", \"" << prefix << "resizes\": " << metrics().resizes.load() - resizesBefore
+                    << ", \"" << prefix << "rehashed_bytes\": " << metrics().rehashedBytes.load() - rehashedBefore;
+            }
+
+            // 3. searchCourse, each lookup timed on its own, misses are course numbers with a suffix
+            cerr << "search " << storage.second << endl;
+            Histogram hits;
+            Histogram misses;
+            if (!ids.empty())
+            {
+                SplitMix rng(7);
+                vector<string> keys;
+                keys.reserve(searches);
+                for (size_t i = 0; i < searches; i++) keys.emplace_back(source.courseNumberOf(ids[rng.below(ids.size())]));
+                for (int pass = 0; pass < 2; pass++)
+                {
+                    Histogram& latency = pass == 0 ? hits : misses;
+                    for (const string& key : keys)
+                    {
+                        auto before = chrono::steady_clock::now();
+                        source.searchCourse(key);
+                        auto after = chrono::steady_clock::now();
+                        latency.record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(after - before).count()));
+                    }
+                    for (string& key : keys) key += '#';
+                }
+            }
+            json << ",\n     \"search_hit_ns\": ";
+            writeJson(json, hits);
+            json << ",\n     \"search_miss_ns\": ";
+            writeJson(json, misses);
+
+            // 4. printAll into a stream that drops the text
+            cerr << "printAll " << storage.second << endl;
+            auto start = chrono::steady_clock::now();
+            source.printAll(nullStream);
+            json << ",\n     \"print_all_ms\": " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+            // 5. title search: one or two words out of course names, every other query with a typo
+            cerr << "title search " << storage.second << endl;
+            start = chrono::steady_clock::now();
+            source.buildIndexes();
+            json << ",\n     \"search_index_ms\": " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            Histogram titleSearch;
+            if (!ids.empty())
+            {
+                SplitMix rng(11);
+                vector<string> words;
+                vector<SearchHit> results;
+                for (size_t q = 0; q < TITLE_QUERIES; q++)
+                {
+                    TitleIndex::tokenize(source.findCourse(source.courseNumberOf(ids[rng.below(ids.size())])).name, words);
+                    if (words.empty()) continue;
+                    string query = words[rng.below(words.size())];
+                    if (words.size() > 1 && rng.uniform() < 0.5) query += " " + words[rng.below(words.size())];
+                    if (q % 2 == 1 && query.size() >= 5) swap(query[1], query[2]);
+                    auto before = chrono::steady_clock::now();
+                    source.searchCourses(query, SEARCH_RESULTS, results);
+                    auto after = chrono::steady_clock::now();
+                    titleSearch.record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(after - before).count()));
+                }
+            }
+            json << ",\n     \"title_search_ns\": ";
+            writeJson(json, titleSearch);
+            json << "}";
+        }
+        json << "\n  ],\n  \"snapshot\": {";
+
+        // 6. snapshot: saved once, then the cold start that replaces the CSV load, and lookups on the mapping
+        cerr << "snapshot" << endl;
+        {
+            CourseHashTable source(StorageMode::Flat);
+            string snapshotPath = filePath + ".snap";
+            streambuf* original = cout.rdbuf(&nullBuffer);
+            loadCourses(filePath, &source, LoadMode::Mapped);
+            auto start = chrono::steady_clock::now();
+            bool saved = source.saveSnapshot(snapshotPath);
+            double saveMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cout.rdbuf(original);
+            if (!saved)
+            {
+                cerr << "Error: Could not write the snapshot " << snapshotPath << endl;
+                metrics().enabled = recording;
+                return false;
+            }
+            vector<string> keys;
+            if (source.Size() > 0)
+            {
+                SplitMix rng(13);
+                vector<CourseId> ids;
+                source.forEachCourse([&](CourseId id, const CourseId*, size_t) { ids.push_back(id); });
+                for (size_t i = 0; i < searches; i++) keys.emplace_back(source.courseNumberOf(ids[rng.below(ids.size())]));
+            }
+            source.Clear();
+
+            CourseHashTable mapped(StorageMode::Flat);
+            double loadMillis[2];
+            for (int verify = 0; verify < 2; verify++)
+            {
+                start = chrono::steady_clock::now();
+                mapped.loadSnapshot(snapshotPath, verify == 1);
+                loadMillis[verify] = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            }
+            Histogram hits;
+            for (const string& key : keys)
+            {
+                auto before = chrono::steady_clock::now();
+                mapped.findCourse(key);
+                auto after = chrono::steady_clock::now();
+                hits.record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(after - before).count()));
+            }
+            json << "\"bytes\": " << fileBytes(snapshotPath) << ", \"save_ms\": " << saveMillis << ", \"load_ms\": " << loadMillis[0]
+                << ", \"load_verified_ms\": " << loadMillis[1] << ",\n    \"find_hit_ns\": ";
+            writeJson(json, hits);
+            mapped.Clear();
+            remove(snapshotPath.c_str());
+        }
+        json << "},\n  \"reader_scaling\": [";
+
+        // 7. findCourse from reader threads on a published catalog, alone and while another thread
+        // keeps loading the file again and publishing it
+        cerr << "reader scaling" << endl;
         {
-            lineNumber++;
-            // if line is empty, continue to next line
-            if (line.empty()) continue;
-
-            vector<string> fields = splitCSV(line);
+            CatalogStore store;
+            streambuf* original = cout.rdbuf(&nullBuffer); // load messages, from the writer thread too
+            unique_ptr<Catalog> initial = make_unique<Catalog>(StorageMode::Flat);
+            loadCourses(filePath, &initial->table, LoadMode::Mapped);
+            vector<string> keys;
+            if (initial->table.Size() > 0)
+            {
+                SplitMix rng(17);
+                vector<CourseId> ids;
+                initial->table.forEachCourse([&](CourseId id, const CourseId*, size_t) { ids.push_back(id); });
+                for (size_t i = 0; i < searches; i++) keys.emplace_back(initial->table.courseNumberOf(ids[rng.below(ids.size())]));
+            }
+            store.publish(move(initial));
 
-            // validation for minimum fields and non-empty fields (courseNumber and name)
-            if (fields.size() < 2)
+            bool firstRow = true;
+            for (size_t threads = 1; !keys.empty() && threads <= max<size_t>(2, workerCount()); threads *= 2)
             {
-                cout << "Error line " << lineNumber << ": Missing course number or name." << endl;
-                file.close();
-                ht->Clear();
-                return false;
+                double rates[2];
+                size_t reloads = 0;
+                for (int reloading = 0; reloading < 2; reloading++)
+                {
+                    atomic<bool> stop{ false };
+                    atomic<size_t> lookups{ 0 };
+                    thread writer;
+                    if (reloading == 1)
+                    {
+                        writer = thread([&]()
+                            {
+                                while (!stop.load())
+                                {
+                                    unique_ptr<Catalog> next = make_unique<Catalog>(StorageMode::Flat);
+                                    if (!loadCourses(filePath, &next->table, LoadMode::Mapped)) break;
+                                    store.publish(move(next));
+                                    reloads++;
+                                }
+                            });
+                    }
+                    vector<thread> readers;
+                    auto start = chrono::steady_clock::now();
+                    for (size_t t = 0; t < threads; t++)
+                    {
+                        readers.emplace_back([&, t]()
+                            {
+                                size_t done = 0;
+                                size_t k = t * 7919;
+                                while (!stop.load(memory_order_relaxed))
+                                {
+                                    // one pin per lookup, the way a request handler would read
+                                    for (size_t i = 0; i < 256; i++, k++)
+                                    {
+                                        CatalogStore::Reader catalog = store.read();
+                                        if (catalog->table.findCourse(keys[k % keys.size()])) done++;
+                                    }
+                                }
+                                lookups += done;
+                            });
+                    }
+                    this_thread::sleep_for(chrono::duration<double>(READ_SECONDS));
+                    stop = true;
+                    for (thread& reader : readers) reader.join();
+                    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                    if (writer.joinable()) writer.join();
+                    store.collect();
+                    rates[reloading] = lookups.load() / seconds;
+                }
+                json << (firstRow ? "\n" : ",\n") << "    {\"threads\": " << threads << ", \"lookups_per_s\": " << rates[0]
+                    << ", \"lookups_per_s_reloading\": " << rates[1] << ", \"reloads_published\": " << reloads << "}";
+                firstRow = false;
             }
-            if (fields[0].empty() || fields[1].empty())
+            cout.rdbuf(original);
+        }
+        json << "\n  ],\n  \"sharded_insert\": [";
+
+        // 8. inserts into a ShardedCourseTable from 1, 2, 4, ... threads: each thread filling shards of
+        // its own (the sharded loader's way), and every thread inserting anywhere through the shard locks
+        cerr << "sharded insert" << endl;
+        {
+            CourseHashTable source(StorageMode::Flat);
+            streambuf* original = cout.rdbuf(&nullBuffer);
+            loadCourses(filePath, &source, LoadMode::Mapped);
+            vector<CourseId> ids;
+            source.forEachCourse([&](CourseId id, const CourseId*, size_t) { ids.push_back(id); });
+            // prerequisites as strings, the way the loaders hand them over
+            vector<CourseView> courses;
+            vector<string_view> prereqs;
+            vector<size_t> firstPrereq;
+            for (CourseId id : ids)
             {
-                cout << "Error line " << lineNumber << ": Empty course number or name." << endl;
-                file.close();
-                ht->Clear();
-                return false;
+                CourseView course = source.findCourse(source.courseNumberOf(id));
+                courses.push_back(course);
+                firstPrereq.push_back(prereqs.size());
+                for (size_t p = 0; p < course.prerequisiteCount; p++) prereqs.push_back(source.courseNumberOf(course.prerequisiteIds[p]));
             }
-            // build course object
-            Course course;
-            course.courseNumber = fields[0];
-            course.name = fields[1];
+            firstPrereq.push_back(prereqs.size());
+            auto insert = [&](ShardedCourseTable& table, size_t i, bool locked)
+                {
+                    const CourseView& course = courses[i];
+                    const string_view* numbers = prereqs.data() + firstPrereq[i];
+                    size_t count = firstPrereq[i + 1] - firstPrereq[i];
+                    if (locked) table.insertFields(course.courseNumber, course.name, numbers, count);
+                    else table.shard(table.shardOf(course.courseNumber)).insertFields(course.courseNumber, course.name, numbers, count);
+                };
 
-            // add prerequisites
-            for (size_t i = 2; i < fields.size(); i++)
+            bool firstRow = true;
+            for (const auto& storage : STORAGE_MODES)
             {
-                const string& prereq = fields[i];
-                if (prereq.empty()) continue;
-                // validate prereqs format
-                if (prereq.length() < 4 || !containsDigit(prereq))
+                for (size_t threads = 1; !ids.empty() && threads <= max<size_t>(2, workerCount()); threads *= 2)
                 {
-                    cout << "Error line " << lineNumber << ": Invalid prerequisite format '" << prereq << "'" << endl;
-                    file.close();
-                    ht->Clear();
-                    return false;
+                    double seconds[2];
+                    for (int locked = 0; locked < 2; locked++)
+                    {
+                        ShardedCourseTable table(threads * 4, storage.first);
+                        // owned: thread t takes shards t, t + threads, ..., locked: every threads-th course
+                        vector<vector<size_t>> work(threads);
+                        for (size_t i = 0; i < ids.size(); i++)
+                        {
+                            size_t owner = locked == 1 ? i % threads : table.shardOf(courses[i].courseNumber) % threads;
+                            work[owner].push_back(i);
+                        }
+                        auto start = chrono::steady_clock::now();
+                        vector<thread> workers;
+                        for (size_t t = 0; t < threads; t++)
+                        {
+                            workers.emplace_back([&, t]()
+                                {
+                                    for (size_t i : work[t]) insert(table, i, locked == 1);
+                                });
+                        }
+                        for (thread& worker : workers) worker.join();
+                        seconds[locked] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                    }
+                    json << (firstRow ? "\n" : ",\n") << "    {\"storage\": \"" << storage.second << "\", \"threads\": " << threads
+                        << ", \"owned_inserts_per_s\": " << ids.size() / seconds[0] << ", \"locked_inserts_per_s\": " << ids.size() / seconds[1] << "}";
+                    firstRow = false;
                 }
-                course.prerequisites.push_back(prereq);
             }
-            // check for duplicates
-            if (courseNumbers.count(course.courseNumber) > 0)
+            cout.rdbuf(original);
+        }
+        json << "\n  ],\n  \"hash_policies\": [";
+
+        // 9. chained table per hash policy: load, collisions next to a random hash's, lookups
+        cerr << "hash policies" << endl;
+        first = true;
+        for (const PolicyResult& result : compareHashPolicies(filePath))
+        {
+            json << (first ? "\n" : ",\n") << "    {\"policy\": " << jsonString(result.name) << ", \"load_ms\": " << result.loadMs
+                << ", \"resizes\": " << result.resizes << ", \"buckets\": " << result.stats.buckets << ", \"collisions\": " << result.stats.collisions
+                << ", \"random_collisions\": " << result.stats.randomCollisions << ", \"longest_chain\": " << result.stats.longest
+                << ", \"mean_probes\": " << result.stats.meanProbes << ", \"lookup_ns\": " << result.lookupNs << "}";
+            first = false;
+        }
+        json << "\n  ],\n  \"columns\": {";
+
+        // 10. report scans: the same filters over the columnar copy and by walking the table
+        cerr << "columns" << endl;
+        {
+            streambuf* original = cout.rdbuf(&nullBuffer);
+            CourseHashTable table;
+            loadCourses(filePath, &table, LoadMode::Mapped);
+            cout.rdbuf(original);
+            table.buildIndexes();
+            auto start = chrono::steady_clock::now();
+            CourseColumns columns;
+            columns.build(table);
+            double buildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+            // best of a few runs, a scan of a small catalog is too quick to time once
+            auto bestOf = [](auto scan)
+                {
+                    double best = 1e300;
+                    for (int run = 0; run < 5; run++)
+                    {
+                        auto begin = chrono::steady_clock::now();
+                        scan();
+                        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count());
+                    }
+                    return best;
+                };
+            // the counts go into the results too, so no scan can be optimized away
+            size_t prereqMatches = 0, levelMatches = 0, walkMatches = 0, largestDepartment = 0;
+            CourseColumns::RowMask mask;
+            double prereqMs = bestOf([&]()
+                {
+                    mask = columns.allRows();
+                    columns.keepPrerequisites(mask, 3, UINT32_MAX);
+                    prereqMatches = columns.count(mask);
+                });
+            double levelMs = bestOf([&]()
+                {
+                    mask = columns.allRows();
+                    columns.keepLevel(mask, 3);
+                    levelMatches = columns.count(mask);
+                });
+            double departmentMs = bestOf([&]()
+                {
+                    mask = columns.allRows();
+                    vector<size_t> counts = columns.countByDepartment(mask);
+                    largestDepartment = counts.empty() ? 0 : *max_element(counts.begin(), counts.end());
+                });
+            double walkMs = bestOf([&]()
+                {
+                    walkMatches = 0;
+                    table.forEachView([&](const CourseView& course) { walkMatches += course.prerequisiteCount >= 3; });
+                });
+            json << "\"courses\": " << columns.size() << ", \"bytes\": " << columns.memoryBytes() << ", \"build_ms\": " << buildMs
+                << ", \"prereq_filter_ms\": " << prereqMs << ", \"prereq_matches\": " << prereqMatches
+                << ", \"level_filter_ms\": " << levelMs << ", \"level_matches\": " << levelMatches
+                << ", \"by_department_ms\": " << departmentMs << ", \"largest_department\": " << largestDepartment
+                << ", \"table_walk_prereq_ms\": " << walkMs << ", \"table_walk_matches\": " << walkMatches;
+        }
+        json << "},\n  \"csv_scan\": [";
+
+        // 11. field splitting only, no parsing: the old getline + splitCSV, the same split on views,
+        // and CsvReader with each mask kernel this CPU has. Best of a few passes over the mapped file.
+        cerr << "csv scan" << endl;
+        {
+            MappedFile file;
+            string_view data = file.open(filePath) ? file.view() : string_view();
+            auto scanRate = [&](auto scan, size_t& fields)
+                {
+                    double best = 1e300;
+                    for (int run = 0; run < 3; run++)
+                    {
+                        fields = 0;
+                        auto begin = chrono::steady_clock::now();
+                        scan(fields);
+                        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - begin).count());
+                    }
+                    return best > 0.0 ? data.size() / best / 1e6 : 0.0;
+                };
+            auto row = [&](const string& scanner, double mbPerSecond, size_t fields, bool firstRow)
+                {
+                    json << (firstRow ? "\n" : ",\n") << "    {\"scanner\": " << jsonString(scanner) << ", \"mb_per_s\": " << mbPerSecond
+                        << ", \"fields\": " << fields << "}";
+                };
+            size_t fields = 0;
+            double rate = scanRate([&](size_t& count)
+                {
+                    istringstream in{ string(data) };
+                    string line;
+                    while (getline(in, line)) count += splitCSV(line).size();
+                }, fields);
+            row("splitCSV", rate, fields, true);
+            rate = scanRate([&](size_t& count)
+                {
+                    vector<string_view> split;
+                    size_t pos = 0;
+                    while (pos < data.size())
+                    {
+                        size_t end = min(data.find('\n', pos), data.size());
+                        splitCSVView(data.substr(pos, end - pos), split);
+                        count += split.size();
+                        pos = end + 1;
+                    }
+                }, fields);
+            row("splitCSVView", rate, fields, false);
+            for (const auto& kernel : csvKernels())
             {
-                cout << "Error line " << lineNumber << ": Duplicate course " << course.courseNumber << endl;
-                file.close();
-                ht->Clear();
-                return false;
+                rate = scanRate([&](size_t& count)
+                    {
+                        StringArena unescaped;
+                        vector<string_view> split;
+                        CsvReader reader(data, unescaped, false, kernel.second);
+                        while (reader.next(split)) count += split.size();
+                    }, fields);
+                row(string("CsvReader ") + kernel.first, rate, fields, false);
             }
+        }
+        json << "\n  ],\n  \"pipeline\": [";
 
-            courseNumbers.insert(course.courseNumber);
-            courses.push_back(course);
-            ht->Insert(course);
+        // 12. where the pipelined loader's time goes, building the table and only validating
+        cerr << "pipeline" << endl;
+        {
+            streambuf* original = cout.rdbuf(&nullBuffer);
+            for (int build = 1; build >= 0; build--)
+            {
+                CourseHashTable table;
+                PipelineStats stats;
+                loadCoursesPipelined(filePath, build ? &table : nullptr, &stats);
+                auto stage = [&](const char* name, const PipelineStats::Stage& timed)
+                    {
+                        json << ", \"" << name << "_ms\": " << timed.busySeconds * 1000.0 << ", \"" << name << "_wait_ms\": " << timed.waitSeconds * 1000.0;
+                    };
+                json << (build ? "\n" : ",\n") << "    {\"mode\": \"" << (build ? "load" : "validate") << "\", \"ms\": " << stats.seconds * 1000.0
+                    << ", \"mb_per_s\": " << (stats.seconds > 0.0 ? stats.bytes / stats.seconds / 1e6 : 0.0) << ", \"blocks\": " << stats.blocks;
+                stage("read", stats.read);
+                stage("parse", stats.parse);
+                stage("insert", stats.insert);
+                json << "}";
+            }
+            cout.rdbuf(original);
         }
-        file.close();
+        json << "\n  ],\n  \"view_cache\": [";
 
-        // validate prerequisites exist
-        for (const Course& course : courses)
+        // 13. option 3's rendered views, 90% of the lookups on 300 popular courses and the rest on any
+        // course, rendered every time and through the view cache
+        cerr << "view cache" << endl;
         {
-            for (const string& prereq : course.prerequisites)
+            streambuf* original = cout.rdbuf(&nullBuffer);
+            CourseHashTable table;
+            loadCourses(filePath, &table, LoadMode::Mapped);
+            cout.rdbuf(original);
+            vector<string_view> numbers;
+            table.forEachCourse([&](CourseId id, const CourseId*, size_t) { numbers.push_back(table.courseNumberOf(id)); });
+            SplitMix rng(11);
+            vector<string_view> popular;
+            for (size_t i = 0; i < 300 && !numbers.empty(); i++) popular.push_back(numbers[rng.below(numbers.size())]);
+            // rendering a long chain every time is slow, fewer lookups are enough here
+            vector<string_view> lookups;
+            for (size_t i = 0; i < min<size_t>(searches, 20000) && !numbers.empty(); i++)
+            {
+                lookups.push_back(rng.uniform() < 0.9 ? popular[rng.below(popular.size())] : numbers[rng.below(numbers.size())]);
+            }
+            bool firstRow = true;
+            for (size_t capacity : { size_t(0), VIEW_CACHE_ENTRIES })
             {
-                if (courseNumbers.count(prereq) == 0)
+                table.setViewCacheCapacity(capacity);
+                ViewCacheStats before = table.viewCacheStatistics();
+                string view;
+                size_t rendered = 0; // the output goes into the results, so no lookup is skipped
+                auto start = chrono::steady_clock::now();
+                for (string_view courseNumber : lookups)
                 {
-                    cout << "Error: Unknown prerequisite " << prereq << " for course " << course.courseNumber << endl;
-                    ht->Clear();
-                    return false;
+                    table.renderedView(courseNumber, view);
+                    rendered += view.size();
                 }
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                ViewCacheStats after = table.viewCacheStatistics();
+                uint64_t hits = after.hits - before.hits;
+                json << (firstRow ? "\n" : ",\n") << "    {\"capacity\": " << capacity << ", \"lookups\": " << lookups.size()
+                    << ", \"ns_per_lookup\": " << (lookups.empty() ? 0.0 : seconds * 1e9 / lookups.size())
+                    << ", \"hit_rate\": " << (lookups.empty() ? 0.0 : static_cast<double>(hits) / lookups.size())
+                    << ", \"evictions\": " << after.evictions - before.evictions << ", \"bytes\": " << after.bytes
+                    << ", \"rendered_bytes\": " << rendered << "}";
+                firstRow = false;
             }
         }
-
-        cout << "Successfully loaded " << courseNumbers.size() << " courses.\n";
+        json << "\n  ],\n  \"peak_rss_kb\": " << peakRssKilobytes() << "\n}\n";
+        metrics().enabled = recording;
         return true;
+    }
 
+    // prints the command line options
+    void printUsage(const char* program)
+    {
+        cerr << "Usage: " << program << " [--load FILE] [--query-file KEYS] [--storage chained|flat] [--stats table|json]\n"
+            << "  [--save-snapshot SNAP] [--no-verify] [--hash polynomial|word] [--hash-seed N] [--max-load F] [--apply CHANGES]\n"
+            << "  [--loader stream|mapped|parallel|pipelined]\n"
+            << "  No options starts the interactive menu.\n"
+            << "  --load FILE        CSV catalog or snapshot to load (default: the ABCU sample file)\n"
+            << "  --query-file KEYS  one course number per line, - or no option reads stdin\n"
+            << "  --storage MODE     hash table storage, chained (default) or flat\n"
+            << "  --stats FORMAT     instrumentation dump to stderr at the end, table or json\n"
+            << "  --save-snapshot SNAP  writes the loaded catalog as a snapshot, and exits without --query-file\n"
+            << "  --no-verify        skips a snapshot's body checksum, for the fastest start\n"
+            << "  --hash POLICY      chained bucket hash, word (default) or the original polynomial\n"
+            << "  --hash-seed N      seeds the word hash, snapshots keep the seed they were written with\n"
+            << "  --max-load F       grows the table past F courses per bucket (default 1) or per flat slot (0.875)\n"
+            << "  --apply CHANGES    applies a change file (+/- lines) or the differences to a full catalog after loading\n"
+            << "  --loader MODE      CSV loader, parallel (default), stream, mapped or pipelined (prints time per stage)\n"
+            << "Results go to stdout, one CSV record per key: the course, or KEY,NOT FOUND. Fields with a comma,\n"
+            << "a quote or a line break are quoted (RFC 4180), so only a name with a line break spans lines.\n"
+            << "Load messages and the throughput/latency summary go to stderr.\n"
+            << "\n" << program << " --validate FILE\n"
+            << "  streams FILE through the pipelined loader's checks without building a table, any size of file\n"
+            << "  (records up to 16 MB), and prints its statistics, exit code 1 if it doesn't load\n"
+            << program << " --generate FILE [catalog options]\n"
+            << "  writes a synthetic catalog and exits\n"
+            << program << " --bench [--load FILE | --generate FILE] [catalog options] [--searches N] [--output JSON]\n"
+            << "  runs the benchmark suite on FILE, or on a generated catalog, results as JSON (stdout by default)\n"
+            << "Catalog options:\n"
+            << "  --courses N        1 to 10000000 (default 100000)\n"
+            << "  --fan-in F         mean prerequisites per course (default 2)\n"
+            << "  --skew S           zipf exponent of the department sizes, 0 for even (default 1)\n"
+            << "  --name-length L    characters per course name (default 24)\n"
+            << "  --departments D    number of department prefixes (default 40)\n"
+            << "  --seed X           generator seed (default 42)\n";
+    }
 
+    /**
+     * readAll
+     *
+     * Reads a whole file, or stdin for "-", into one string.
+     * @return false if the file can't be opened.
+     */
+    bool readAll(const string& path, string& text)
+    {
+        if (path == "-")
+        {
+            ostringstream buffer;
+            buffer << cin.rdbuf();
+            text = buffer.str();
+            return true;
+        }
+        ifstream file(path, ios::binary);
+        if (!file.is_open()) return false;
+        file.seekg(0, ios::end);
+        text.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0, ios::beg);
+        file.read(&text[0], static_cast<streamsize>(text.size()));
+        return true;
     }
 
     /**
-     * displayCourse information is used in case 3 from the main menu
-     * to format output so it looks nice.
+     * runBatch
      *
-     * @param course data to display.
-     * @return the course information displayed properly.
+     * Non-interactive mode: loads once, resolves every key from the query input and writes the
+     * results through one buffer with no per-line flush. Each lookup is timed on its own for the
+     * latency percentiles printed at the end.
+     *
+     * @param argc, argv from main.
+     * @return the process exit code.
      */
+    int runBatch(int argc, char* argv[])
+    {
+        string loadPath = "CS 300 ABCU_Advising_Program_Input.csv";
+        string queryPath = "-";
+        bool queryGiven = false;
+        string snapshotPath;
+        string changesPath;
+        bool verify = true;
+        StorageMode storage = StorageMode::Chained;
+        LoadMode loadMode = LoadMode::Parallel;
+        string validatePath;
+        HashPolicy policy = HashPolicy::Word;
+        uint64_t hashSeed = 0;
+        double maxLoad = 0.0; // 0 keeps the storage's default
+        string stats; // empty for no statistics
+        bool loadGiven = false;
+        bool bench = false;
+        string generatePath, outputPath;
+        CatalogOptions catalog;
+        size_t searches = 200000;
+        bool valid = true;
+        // numbers have to parse completely and fall in [low, high]
+        auto number = [&](const char* text, double low, double high)
+            {
+                char* end = nullptr;
+                double value = strtod(text, &end);
+                if (end == text || *end != '\0' || !(value >= low && value <= high)) valid = false;
+                return value;
+            };
+        for (int i = 1; i < argc; i++)
+        {
+            string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--load" && hasValue)
+            {
+                loadPath = argv[++i];
+                loadGiven = true;
+            }
+            else if (arg == "--bench") bench = true;
+            else if (arg == "--generate" && hasValue) generatePath = argv[++i];
+            else if (arg == "--output" && hasValue) outputPath = argv[++i];
+            else if (arg == "--courses" && hasValue) catalog.courses = static_cast<size_t>(number(argv[++i], 1, MAX_GENERATED_COURSES));
+            else if (arg == "--fan-in" && hasValue) catalog.fanIn = number(argv[++i], 0, 64);
+            else if (arg == "--skew" && hasValue) catalog.skew = number(argv[++i], 0, 8);
+            else if (arg == "--name-length" && hasValue) catalog.nameLength = static_cast<size_t>(number(argv[++i], 1, 256));
+            else if (arg == "--departments" && hasValue) catalog.departments = static_cast<size_t>(number(argv[++i], 1, MAX_DEPARTMENTS));
+            else if (arg == "--seed" && hasValue) catalog.seed = static_cast<uint64_t>(number(argv[++i], 0, 9007199254740992.0));
+            else if (arg == "--searches" && hasValue) searches = static_cast<size_t>(number(argv[++i], 1, 1e9));
+            else if (arg == "--query-file" && hasValue)
+            {
+                queryPath = argv[++i];
+                queryGiven = true;
+            }
+            else if (arg == "--save-snapshot" && hasValue) snapshotPath = argv[++i];
+            else if (arg == "--apply" && hasValue) changesPath = argv[++i];
+            else if (arg == "--validate" && hasValue) validatePath = argv[++i];
+            else if (arg == "--loader" && hasValue)
+            {
+                string value = argv[++i];
+                bool known = false;
+                for (const auto& load : LOAD_MODES)
+                {
+                    if (value != load.second) continue;
+                    loadMode = load.first;
+                    known = true;
+                }
+                if (!known)
+                {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            }
+            else if (arg == "--no-verify") verify = false;
+            else if (arg == "--max-load" && hasValue) maxLoad = number(argv[++i], 0.25, 8);
+            else if (arg == "--hash-seed" && hasValue) hashSeed = static_cast<uint64_t>(number(argv[++i], 0, 9007199254740992.0));
+            else if (arg == "--hash" && hasValue)
+            {
+                string value = argv[++i];
+                if (value == "polynomial") policy = HashPolicy::Polynomial;
+                else if (value != "word")
+                {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            }
+            else if (arg == "--storage" && hasValue)
+            {
+                string value = argv[++i];
+                if (value == "flat") storage = StorageMode::Flat;
+                else if (value != "chained")
+                {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            }
+            else if (arg == "--stats" && hasValue)
+            {
+                stats = argv[++i];
+                if (stats != "table" && stats != "json")
+                {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            }
+            else
+            {
+                printUsage(argv[0]);
+                return arg == "--help" ? 0 : 1;
+            }
+        }
+        if (!valid)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        // only pay for the instrumentation when it's asked for
+        metrics().enabled = !stats.empty();
+
+        if (!generatePath.empty() || bench)
+        {
+            // the suite runs on the generated catalog, or on --load as given
+            bool generate = !generatePath.empty() || !loadGiven;
+            string catalogPath = !generatePath.empty() ? generatePath : (loadGiven ? loadPath : "bench_catalog.csv");
+            if (generate)
+            {
+                cerr << "Generating " << catalog.courses << " courses to " << catalogPath << endl;
+                if (!generateCatalog(catalogPath, catalog)) return 1;
+            }
+            if (!bench) return 0;
+
+            ostringstream json;
+            bool ran = runBenchSuite(catalogPath, generate ? &catalog : nullptr, searches, json);
+            // a catalog generated only for this run is scratch
+            if (generate && generatePath.empty()) remove(catalogPath.c_str());
+            if (!ran) return 1;
+            if (outputPath.empty())
+            {
+                cout << json.str();
+                return 0;
+            }
+            ofstream output(outputPath);
+            if (!output.is_open())
+            {
+                cerr << "Error: Could not open file " << outputPath << endl;
+                return 1;
+            }
+            output << json.str();
+            cerr << "Results written to " << outputPath << endl;
+            return 0;
+        }
+
+        if (!validatePath.empty())
+        {
+            // loader messages to stderr, the figures to stdout
+            PipelineStats validation;
+            streambuf* original = cout.rdbuf(cerr.rdbuf());
+            bool passed = loadCoursesPipelined(validatePath, nullptr, &validation);
+            cout.rdbuf(original);
+            cout << "bytes: " << validation.bytes << "\nlines: " << validation.lines << "\ncourses: " << validation.courses
+                << "\nprerequisites: " << validation.prerequisites << "\nmost prerequisites: " << validation.maxPrerequisites
+                << "\ncourse numbers: " << validation.courseNumbers << "\nblocks: " << validation.blocks
+                << "\nseconds: " << validation.seconds << "\nMB/s: " << (validation.seconds > 0.0 ? validation.bytes / validation.seconds / 1e6 : 0.0)
+                << "\nvalid: " << (passed ? "yes" : "no") << endl;
+            return passed ? 0 : 1;
+        }
+
+        ios::sync_with_stdio(false);
+        CourseHashTable table(storage, policy, hashSeed);
+        if (maxLoad > 0.0) table.setMaxLoadFactor(maxLoad);
+
+        // the loader talks on cout, keep stdout for results only
+        auto loadStart = chrono::steady_clock::now();
+        streambuf* original = cout.rdbuf(cerr.rdbuf());
+        bool loaded = loadCatalog(loadPath, &table, verify, loadMode);
+        cout.rdbuf(original);
+        double loadMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count();
+        if (!loaded) return 1;
+
+        if (!changesPath.empty())
+        {
+            auto applyStart = chrono::steady_clock::now();
+            original = cout.rdbuf(cerr.rdbuf());
+            bool applied = applyCatalogChanges(changesPath, &table);
+            cout.rdbuf(original);
+            if (!applied) return 1;
+            cerr << "Changes applied in " << chrono::duration<double, milli>(chrono::steady_clock::now() - applyStart).count() << " ms\n";
+        }
+
+        if (!snapshotPath.empty())
+        {
+            auto saveStart = chrono::steady_clock::now();
+            original = cout.rdbuf(cerr.rdbuf());
+            bool saved = table.saveSnapshot(snapshotPath);
+            cout.rdbuf(original);
+            if (!saved) return 1;
+            cerr << "Loaded " << table.Size() << " courses in " << loadMillis << " ms, snapshot " << snapshotPath << " written in "
+                << chrono::duration<double, milli>(chrono::steady_clock::now() - saveStart).count() << " ms\n";
+            if (!queryGiven) return 0;
+        }
+
+        string queries;
+        if (!readAll(queryPath, queries))
+        {
+            cerr << "Error: Could not open file " << queryPath << endl;
+            return 1;
+        }
+        // same as the menu, course numbers are matched upper case
+        transform(queries.begin(), queries.end(), queries.begin(), ::toupper);
+
+        vector<uint64_t> latencies; // ns per lookup
+        latencies.reserve(queries.size() / 8);
+        string output;
+        output.reserve(OUTPUT_FLUSH_BYTES + 4096);
+        size_t found = 0;
+
+        auto start = chrono::steady_clock::now();
+        size_t pos = 0;
+        while (pos < queries.size())
+        {
+            size_t end = queries.find('\n', pos);
+            if (end == string::npos) end = queries.size();
+            string_view key = trimView(string_view(queries).substr(pos, end - pos));
+            pos = end + 1;
+            if (key.empty()) continue;
 
-    void displayCourse(const Course& course) {
-        cout << course.courseNumber << ", " << course.name << endl;
-        if (!course.prerequisites.empty()) {
-            cout << "Prerequisites: ";
-            for (size_t i = 0; i < course.prerequisites.size(); i++) {
-                cout << course.prerequisites[i];
-                if (i < course.prerequisites.size() - 1) cout << ", ";
+            auto before = chrono::steady_clock::now();
+            CourseView course = table.findCourse(key);
+            auto after = chrono::steady_clock::now();
+            latencies.push_back(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(after - before).count()));
+
+            if (course)
+            {
+                found++;
+                appendCsvField(output, course.courseNumber);
+                output += ',';
+                appendCsvField(output, course.name);
+                for (size_t i = 0; i < course.prerequisiteCount; i++)
+                {
+                    output += ',';
+                    appendCsvField(output, table.courseNumberOf(course.prerequisiteIds[i]));
+                }
+                output.append("\n");
+            }
+            else
+            {
+                appendCsvField(output, key);
+                output.append(",NOT FOUND\n");
+            }
+            if (output.size() >= OUTPUT_FLUSH_BYTES)
+            {
+                cout.write(output.data(), static_cast<streamsize>(output.size()));
+                output.clear();
             }
-            cout << endl;
         }
-        else {
-            cout << "No prerequisites" << endl;
+        cout.write(output.data(), static_cast<streamsize>(output.size()));
+        cout.flush();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        size_t total = latencies.size();
+        cerr << "Loaded " << table.Size() << " courses in " << loadMillis << " ms\n";
+        cerr << "Queries: " << total << " (" << found << " found, " << total - found << " not found)\n";
+        if (total > 0)
+        {
+            sort(latencies.begin(), latencies.end());
+            auto percentile = [&](double p)
+                {
+                    return latencies[min(total - 1, static_cast<size_t>(p * total))];
+                };
+            cerr << "Throughput: " << total / seconds << " queries/s (" << seconds * 1000.0 << " ms incl. output)\n";
+            cerr << "Lookup latency ns: p50 " << percentile(0.50) << ", p90 " << percentile(0.90)
+                << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999)
+                << ", max " << latencies.back() << "\n";
         }
+        if (!stats.empty()) printStatistics(cerr, table, stats == "json");
+        return 0;
     }
 }
 
@@ -601,11 +8017,16 @@ namespace
 // Main function
 //============================================================================
 
-int main()
+// the tests include this file for its internals and bring their own main
+#ifndef PROJECTTWO_NO_MAIN
+int main(int argc, char* argv[])
 {
-    CourseHashTable* courseTable = new CourseHashTable();
+    // any option means batch mode, no menu
+    if (argc > 1) return runBatch(argc, argv);
+
+    // loads build a new catalog and publish it, the menu reads whichever is current
+    CatalogStore catalogs;
     string csvPath, courseNumber;
-    clock_t ticks;
 
     cout << "Welcome to the Course Planner.\n";
 
@@ -615,6 +8036,14 @@ int main()
         cout << "\n 1. Load Data Structure\n";
         cout << " 2. Print Course List\n";
         cout << " 3. Search and Print Course\n";
+        cout << " 4. Run Benchmarks\n";
+        cout << " 5. Show Full Prerequisite Chain\n";
+        cout << " 6. Generate Semester Plan\n";
+        cout << " 7. Show Statistics\n";
+        cout << " 8. List Courses by Prefix\n";
+        cout << "10. Save Snapshot\n";
+        cout << "11. Apply Catalog Changes\n";
+        cout << "12. Course Report\n";
         cout << " 9. Exit\n";
         cout << "Enter your choice: \n";
         cin >> choice;
@@ -627,10 +8056,16 @@ int main()
         }
         cin.ignore();  // clear newline
 
+        // catalogs replaced by earlier loads go once nothing reads them
+        catalogs.collect();
+        CatalogStore::Reader current = catalogs.read();
+        const CourseHashTable* courseTable = &current->table;
+        const PrerequisiteGraph& prereqGraph = current->graph;
+
         // get user choice from input
         switch (choice) {
         case 1: {
-        		cout << "Enter CSV file path (or press Enter for default): ";
+        		cout << "Enter CSV or snapshot file path (or press Enter for default): ";
         		getline(cin, csvPath);
 
         		if (csvPath.empty()) {
@@ -638,22 +8073,37 @@ int main()
         			cout << "Using default file: " << csvPath << endl;
         		}
 
-        		ticks = clock();
+        		auto start = chrono::steady_clock::now();
 
-        		bool loaded = loadCourses(csvPath, courseTable);
+        		// built aside, the current catalog stays readable until the new one is complete
+        		unique_ptr<Catalog> next = make_unique<Catalog>();
+        		bool loaded = loadCatalog(csvPath, &next->table);
         		if (!loaded) {
         			cout << "Trying default file." << endl;
-        			loaded = loadCourses("CS 300 ABCU_Advising_Program_Input.csv", courseTable);
+        			loaded = loadCourses("CS 300 ABCU_Advising_Program_Input.csv", &next->table);
         		}
-        		if (loaded) {
-        			ticks = clock() - ticks;
-        			cout << "Data structure loaded." << endl;
-        			cout << "Time: " << ticks << " clock ticks" << endl;
-        			cout << "Time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
-        		}
-        		else {
+        		if (!loaded) {
         			cout << "Failed to load courses." << endl;
+        			if (courseTable->Size() > 0) {
+        				cout << "Keeping the " << courseTable->Size() << " courses already loaded." << endl;
+        			}
+        			break;
         		}
+        		double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        		cout << "Data structure loaded." << endl;
+        		cout << "Time: " << millis << " milliseconds" << endl;
+        		cout << "Memory: " << next->table.memoryBytes() << " bytes, "
+        			<< next->table.memoryBytes() / max<size_t>(1, next->table.Size()) << " per course" << endl;
+        		next->graph.build(next->table);
+        		next->graph.buildClosure();
+        		// cached views of courses the reload didn't change stay
+        		next->table.carryViews(*courseTable);
+        		// listing and search indexes too, so the first search doesn't wait for them.
+        		// a snapshot is about starting fast, it builds them on first use instead
+        		if (next->table.Mode() != StorageMode::Snapshot) {
+        			next->table.buildIndexes();
+        		}
+        		catalogs.publish(move(next));
         		break;
         }
 
@@ -681,19 +8131,160 @@ int main()
         		}
 
         		transform(courseNumber.begin(), courseNumber.end(), courseNumber.begin(), ::toupper);
-        		ticks = clock();
-        		Course course = courseTable->searchCourse(courseNumber);
-        		ticks = clock() - ticks;
+        		// popular courses come rendered out of the table's view cache
+        		auto start = chrono::steady_clock::now();
+        		string view;
+        		bool found = courseTable->renderedView(courseNumber, view);
+        		double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
 
-        		if (!course.courseNumber.empty()) {
-        			displayCourse(course);
+        		if (found) {
+        			cout << view;
         		}
         		else {
+        			// not a course number, try it as a prefix or title keywords
+        			vector<SearchHit> hits;
+        			start = chrono::steady_clock::now();
+        			courseTable->searchCourses(courseNumber, SEARCH_RESULTS, hits);
+        			micros += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        			cout << "Course '" << courseNumber << "' not found." << endl;
+        			if (!hits.empty()) {
+        				cout << "Closest matches:" << endl;
+        				for (const SearchHit& hit : hits) {
+        					cout << "  " << hit.course.courseNumber << ", " << hit.course.name << endl;
+        				}
+        			}
+        		}
+
+        		cout << "Time: " << micros << " microseconds" << endl;
+        		break;
+        }
+
+        case 4: {
+        		cout << "Enter CSV file path (or press Enter for default): ";
+        		getline(cin, csvPath);
+        		if (csvPath.empty()) {
+        			csvPath = "CS 300 ABCU_Advising_Program_Input.csv";
+        		}
+        		benchmarkLoadPaths(csvPath);
+        		cout << "\nHash policies (chained storage)\n";
+        		for (const PolicyResult& result : compareHashPolicies(csvPath)) {
+        			if (result.loadMs < 0) {
+        				cout << "  " << result.name << ": load failed\n";
+        				continue;
+        			}
+        			cout << "  " << result.name << ": " << result.loadMs << " ms load, " << result.resizes << " resizes, "
+        				<< result.stats.collisions << " collisions (random hash: " << result.stats.randomCollisions << "), longest chain "
+        				<< result.stats.longest << ", " << result.lookupNs << " ns/lookup\n";
+        		}
+        		// lookups run against whatever is loaded
+        		if (courseTable->Size() > 0) {
+        			benchmarkLookups(*courseTable);
+        		}
+        		break;
+        }
+
+        case 5: {
+        		if (courseTable->Size() == 0) {
+        			cout << "No courses loaded. Please load data first." << endl;
+        			break;
+        		}
+
+        		cout << "What course do you want the full chain for? ";
+        		getline(cin, courseNumber);
+        		transform(courseNumber.begin(), courseNumber.end(), courseNumber.begin(), ::toupper);
+
+        		CourseId id = courseTable->idOf(courseNumber);
+        		if (!courseTable->isCourse(id)) {
         			cout << "Course '" << courseNumber << "' not found." << endl;
+        			break;
         		}
 
-        		cout << "Time: " << ticks << " clock ticks" << endl;
-        		cout << "Time: " << ticks * 1.0 / CLOCKS_PER_SEC << " seconds" << endl;
+        		auto start = chrono::steady_clock::now();
+        		vector<CourseId> ancestors = prereqGraph.ancestors(id);
+        		vector<CourseId> descendants = prereqGraph.descendants(id);
+        		double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        		displayChain(courseNumber + " requires", ancestors, *courseTable);
+        		displayChain(courseNumber + " is required by", descendants, *courseTable);
+        		cout << "Time: " << micros << " microseconds" << (prereqGraph.hasClosure() ? " (closure)" : " (BFS)") << endl;
+        		break;
+        }
+
+        case 6: {
+        		if (courseTable->Size() == 0) {
+        			cout << "No courses loaded. Please load data first." << endl;
+        			break;
+        		}
+
+        		cout << "Max courses per term (0 or Enter for no limit): ";
+        		string limitText;
+        		getline(cin, limitText);
+        		size_t maxPerTerm = 0;
+        		if (!limitText.empty()) {
+        			maxPerTerm = static_cast<size_t>(strtoul(limitText.c_str(), nullptr, 10));
+        		}
+
+        		auto start = chrono::steady_clock::now();
+        		SemesterPlan plan = planSemesters(prereqGraph, maxPerTerm);
+        		double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        		if (!plan.valid) {
+        			cout << "Error: prerequisite cycle ";
+        			for (size_t i = 0; i < plan.cycle.size(); i++) {
+        				cout << courseTable->courseNumberOf(plan.cycle[i]);
+        				if (i < plan.cycle.size() - 1) cout << " -> ";
+        			}
+        			cout << "\n" << plan.stuck << " courses can't be scheduled." << endl;
+        		}
+        		else {
+        			for (size_t t = 0; t < plan.terms.size(); t++) {
+        				displayChain("Term " + to_string(t + 1), plan.terms[t], *courseTable);
+        			}
+        			cout << plan.terms.size() << " terms." << endl;
+        		}
+        		cout << "Time: " << millis << " ms" << endl;
+        		break;
+        }
+
+        case 7: {
+        		cout << "Format, table or json (press Enter for table): ";
+        		string format;
+        		getline(cin, format);
+        		printStatistics(cout, *courseTable, format == "json");
+        		break;
+        }
+
+        case 8: {
+        		if (courseTable->Size() == 0) {
+        			cout << "No courses loaded. Please load data first." << endl;
+        			break;
+        		}
+
+        		cout << "Course number prefix, e.g. CSCI3 (or press Enter for all): ";
+        		string prefix;
+        		getline(cin, prefix);
+        		prefix = trim(prefix);
+        		transform(prefix.begin(), prefix.end(), prefix.begin(), ::toupper);
+
+        		// one page at a time, Enter shows the next one
+        		vector<CourseView> page;
+        		size_t offset = 0;
+        		while (true) {
+        			size_t total = courseTable->listCourses(prefix, offset, LIST_PAGE_SIZE, page);
+        			if (total == 0) {
+        				cout << "No courses start with '" << prefix << "'." << endl;
+        				break;
+        			}
+        			for (const CourseView& course : page) {
+        				cout << course.courseNumber << ", " << course.name << "\n";
+        			}
+        			cout << "Courses " << offset + 1 << "-" << offset + page.size() << " of " << total << endl;
+        			offset += page.size();
+        			if (offset >= total) break;
+        			cout << "Press Enter for more, or type anything to stop: ";
+        			string answer;
+        			if (!getline(cin, answer) || !answer.empty()) break;
+        		}
         		break;
         }
 
@@ -701,12 +8292,100 @@ int main()
             cout << "Thank you for using the course planner!" << endl;
             break;
 
+        case 10: {
+        		if (courseTable->Size() == 0) {
+        			cout << "No courses loaded. Please load data first." << endl;
+        			break;
+        		}
+
+        		cout << "Snapshot file path (or press Enter for courses.snap): ";
+        		string snapshotPath;
+        		getline(cin, snapshotPath);
+        		if (snapshotPath.empty()) {
+        			snapshotPath = "courses.snap";
+        		}
+
+        		auto start = chrono::steady_clock::now();
+        		if (courseTable->saveSnapshot(snapshotPath)) {
+        			double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        			cout << "Saved " << courseTable->Size() << " courses to " << snapshotPath << endl;
+        			cout << "Time: " << millis << " milliseconds" << endl;
+        		}
+        		break;
+        }
+
+        case 11: {
+        		if (courseTable->Size() == 0) {
+        			cout << "No courses loaded. Please load data first." << endl;
+        			break;
+        		}
+
+        		cout << "Change file (+/- lines) or full catalog to compare with: ";
+        		string changesPath;
+        		getline(cin, changesPath);
+
+        		// published catalogs are read only, the changes go into a copy that replaces it
+        		auto start = chrono::steady_clock::now();
+        		unique_ptr<Catalog> next = make_unique<Catalog>(courseTable->Mode());
+        		next->table.copyFrom(*courseTable);
+        		double copyMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        		if (!applyCatalogChanges(changesPath, &next->table)) {
+        			cout << "No changes applied, keeping the " << courseTable->Size() << " courses loaded." << endl;
+        			break;
+        		}
+        		next->graph.build(next->table);
+        		next->graph.buildClosure();
+        		next->table.buildIndexes();
+        		double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        		cout << "Time: " << millis << " milliseconds (" << copyMillis << " copying the catalog)" << endl;
+        		catalogs.publish(move(next));
+        		break;
+        }
+
+        case 12: {
+        		if (courseTable->Size() == 0) {
+        			cout << "No courses loaded. Please load data first." << endl;
+        			break;
+        		}
+
+        		ReportFilter filter;
+        		cout << "Course number prefix, e.g. CSCI (or press Enter for all): ";
+        		getline(cin, filter.prefix);
+        		filter.prefix = trim(filter.prefix);
+        		transform(filter.prefix.begin(), filter.prefix.end(), filter.prefix.begin(), ::toupper);
+        		cout << "Minimum prerequisites (or press Enter for any): ";
+        		string answer;
+        		getline(cin, answer);
+        		if (!trim(answer).empty()) {
+        			filter.minPrerequisites = static_cast<uint32_t>(strtoul(answer.c_str(), nullptr, 10));
+        		}
+        		cout << "Level, the first digit of the course number (or press Enter for any): ";
+        		getline(cin, answer);
+        		answer = trim(answer);
+        		if (answer.size() == 1 && isdigit(static_cast<unsigned char>(answer[0]))) {
+        			filter.level = answer[0] - '0';
+        		}
+        		else if (!answer.empty()) {
+        			cout << "Invalid level, reporting every level." << endl;
+        		}
+
+        		// the first report on a catalog builds its columns
+        		auto start = chrono::steady_clock::now();
+        		const CourseColumns& columns = current->columns();
+        		double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        		if (millis >= 1.0) {
+        			cout << "Columns built in " << millis << " milliseconds, " << columns.memoryBytes() << " bytes" << endl;
+        		}
+        		printReport(cout, columns, filter);
+        		break;
+        }
+
         default:
             cout << choice << " is not a valid option, please try again." << endl;
             break;
         }
     }
 
-    delete courseTable;
     return 0;
-}
\ No newline at end of file
+}
+#endif
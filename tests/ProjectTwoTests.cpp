@@ -0,0 +1,453 @@
+/***************************************************************************
+ * ProjectTwo tests.
+ * Builds ProjectTwo.cpp into the same translation unit (without its main),
+ * so the loaders, tables and CSV reader are checked directly. Every check
+ * that fails is printed, and the exit code is the number of failures.
+ ***************************************************************************/
+#define PROJECTTWO_NO_MAIN
+#include "../ProjectTwo.cpp"
+
+namespace
+{
+    int failures = 0;
+
+    // records a failed check with where it is and what was expected
+    void check(bool ok, const string& what, const char* file, int line)
+    {
+        if (ok) return;
+        failures++;
+        cerr << file << ":" << line << ": FAILED " << what << endl;
+    }
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQ(actual, expected) check((actual) == (expected), string(#actual " == " #expected), __FILE__, __LINE__)
+
+    // silences cout (the loaders talk on it) for as long as it lives
+    class Quiet
+    {
+    public:
+        Quiet() : original(cout.rdbuf(&nullBuffer)) {}
+        ~Quiet() { cout.rdbuf(original); }
+
+    private:
+        NullBuffer nullBuffer;
+        streambuf* original;
+    };
+
+    void writeFile(const string& path, const string& text)
+    {
+        ofstream file(path, ios::binary | ios::trunc);
+        file << text;
+    }
+
+    /**
+     * dump
+     *
+     * Every course as a CSV record with its prerequisites, in course number order, to compare
+     * tables that were built differently.
+     */
+    string dump(const CourseHashTable& table)
+    {
+        vector<CourseView> page;
+        table.listCourses("", 0, SIZE_MAX, page);
+        string text;
+        for (const CourseView& course : page)
+        {
+            appendCsvField(text, course.courseNumber);
+            text += ',';
+            appendCsvField(text, course.name);
+            for (size_t i = 0; i < course.prerequisiteCount; i++)
+            {
+                text += ',';
+                appendCsvField(text, table.courseNumberOf(course.prerequisiteIds[i]));
+            }
+            text += '\n';
+        }
+        return text;
+    }
+
+    // the records CsvReader finds in text, fields joined by | and records by /, or the error and its line
+    string readAll(string_view text, bool detectHeader = true, CsvMaskFn kernel = csvMaskKernel())
+    {
+        StringArena unescaped;
+        vector<string_view> fields;
+        CsvReader reader(text, unescaped, detectHeader, kernel);
+        string records;
+        while (reader.next(fields))
+        {
+            for (size_t i = 0; i < fields.size(); i++) records.append(i == 0 ? "" : "|").append(fields[i]);
+            records += '/';
+        }
+        if (!reader.error().empty()) records += "error " + to_string(reader.line()) + ": " + reader.error();
+        return records;
+    }
+
+    // RFC 4180 fields, line numbers and errors, with every scanning kernel
+    void testCsvReader()
+    {
+        for (const auto& kernel : csvKernels())
+        {
+            auto read = [&](string_view text, bool detectHeader = true) { return readAll(text, detectHeader, kernel.second); };
+            CHECK_EQ(read("CSCI100,Intro\nCSCI200,Next,CSCI100\n"), "CSCI100|Intro/CSCI200|Next|CSCI100/");
+            // quoted commas, doubled quotes, an empty quoted field
+            CHECK_EQ(read("CSCI100,\"Data, Part I\"\nCSCI200,\"Say \"\"hi\"\"\",\"\"\n"), "CSCI100|Data, Part I/CSCI200|Say \"hi\"|/");
+            // CRLF line ends, a missing last newline and blank lines
+            CHECK_EQ(read("CSCI100,Intro\r\n\r\nCSCI200,\"Next\"\r\n\nCSCI300,Last"), "CSCI100|Intro/CSCI200|Next/CSCI300|Last/");
+            // a header row is skipped only when asked to look for one
+            CHECK_EQ(read("Course Number,Name\nCSCI100,Intro\n"), "CSCI100|Intro/");
+            CHECK_EQ(read("Course Number,Name\nCSCI100,Intro\n", false), "Course Number|Name/CSCI100|Intro/");
+            // blanks around fields are trimmed, quoted text keeps them
+            CHECK_EQ(read(" CSCI100 , \" Intro \" \n"), "CSCI100| Intro /");
+            // a line break inside quotes, later records keep their file line numbers
+            CHECK_EQ(read("CSCI100,\"Two\nlines\"\nCSCI200,\"oops\n"), "CSCI100|Two\nlines/error 3: Unterminated quoted field.");
+            CHECK_EQ(read("CSCI100,\"Intro\"x\n"), "error 1: Unexpected text after a quoted field.");
+            CHECK_EQ(read("CSCI100,In\"tro\n"), "error 1: Quote inside an unquoted field.");
+            // fields longer than the 64 byte scanning blocks
+            string longName(150, 'n');
+            longName[70] = ',';
+            CHECK_EQ(read("CSCI100,\"" + longName + "\"\n"), "CSCI100|" + longName + "/");
+        }
+
+        // what appendCsvField writes reads back as the same fields
+        const char* samples[] = { "plain", "with, comma", "with \"quotes\"", "two\nlines", "cr\rhere", "" };
+        string record;
+        for (const char* sample : samples)
+        {
+            if (!record.empty()) record += ',';
+            appendCsvField(record, sample);
+        }
+        CHECK_EQ(record, "plain,\"with, comma\",\"with \"\"quotes\"\"\",\"two\nlines\",\"cr\rhere\",");
+        CHECK_EQ(readAll(record + "\n", false), "plain|with, comma|with \"quotes\"|two\nlines|cr\rhere|/");
+    }
+
+    // every loader, storage mode and the sharded loader build the same catalog, or reject the same file
+    void testLoadersAgree()
+    {
+        const string generated = "test_catalog.csv";
+        CatalogOptions options;
+        options.courses = 20000;
+        {
+            Quiet quiet;
+            CHECK(generateCatalog(generated, options));
+        }
+        const string quoted = "test_quoted.csv";
+        writeFile(quoted, "Course Number,Name,Prerequisite\r\nCSCI100,\"Data, Part I\"\r\n"
+            "CSCI200,\"Say \"\"hi\"\"\nagain\",CSCI100\r\n\r\nCSCI300,Last,CSCI100,CSCI200");
+
+        for (const string& path : { generated, quoted })
+        {
+            string expected;
+            for (const auto& storage : STORAGE_MODES)
+            {
+                for (const auto& load : LOAD_MODES)
+                {
+                    CourseHashTable table(storage.first);
+                    bool loaded;
+                    {
+                        Quiet quiet;
+                        loaded = loadCourses(path, &table, load.first);
+                    }
+                    CHECK(loaded);
+                    string text = dump(table);
+                    if (expected.empty()) expected = text;
+                    check(text == expected, path + " loads the same with " + storage.second + "/" + load.second, __FILE__, __LINE__);
+                }
+            }
+            CHECK(!expected.empty());
+
+            // the sharded table holds the same courses
+            ShardedCourseTable sharded;
+            bool loaded;
+            {
+                Quiet quiet;
+                loaded = loadCoursesSharded(path, &sharded);
+            }
+            CHECK(loaded);
+            CourseHashTable reference;
+            {
+                Quiet quiet;
+                loadCourses(path, &reference, LoadMode::Mapped);
+            }
+            CHECK_EQ(sharded.Size(), reference.Size());
+            reference.forEachView([&](const CourseView& course)
+                {
+                    Course copy = sharded.searchCourse(string(course.courseNumber));
+                    check(copy.name == course.name && copy.prerequisites.size() == course.prerequisiteCount,
+                        "sharded " + string(course.courseNumber), __FILE__, __LINE__);
+                });
+        }
+
+        // bad files fail in every mode with the same message
+        const pair<const char*, const char*> bad[] = {
+            { "CSCI100,Intro\nCSCI100,Again\n", "Error line 2: Duplicate course CSCI100" },
+            { "CSCI100,Intro,CSCI999\n", "Error: Unknown prerequisite CSCI999 for course CSCI100" },
+            { "CSCI100,Intro\nCSCI200,\"open\nCSCI300,x\n", "Error line 2: Unterminated quoted field." },
+            { "CSCI100\n", "Error line 1: Missing course number or name." },
+            { "CSCI100,Intro,X\n", "Error line 1: Invalid prerequisite format 'X'" },
+        };
+        const string badPath = "test_bad.csv";
+        for (const auto& file : bad)
+        {
+            writeFile(badPath, file.first);
+            for (const auto& load : LOAD_MODES)
+            {
+                CourseHashTable table;
+                ostringstream messages;
+                streambuf* original = cout.rdbuf(messages.rdbuf());
+                bool loaded = loadCourses(badPath, &table, load.first);
+                cout.rdbuf(original);
+                check(!loaded && table.Size() == 0, string(load.second) + " rejects " + file.first, __FILE__, __LINE__);
+                check(messages.str().find(file.second) != string::npos, string(load.second) + " says " + file.second, __FILE__, __LINE__);
+            }
+        }
+        remove(generated.c_str());
+        remove(quoted.c_str());
+        remove(badPath.c_str());
+    }
+
+    // records longer than a pipeline block load everywhere, an open quote stops at the record limit
+    void testLongRecords()
+    {
+        const string path = "test_long.csv";
+        string names[] = { string(PIPELINE_BLOCK_BYTES * 5 / 2, 'a'), string(PIPELINE_BLOCK_BYTES * 2, 'b') };
+        writeFile(path, "CSCI100,Intro\nCSCI200,\"" + names[0] + "\",CSCI100\nCSCI300,\"" + names[1] + "\",CSCI200\nCSCI500,Capstone,CSCI300\n");
+        for (const auto& load : LOAD_MODES)
+        {
+            CourseHashTable table;
+            bool loaded;
+            {
+                Quiet quiet;
+                loaded = loadCourses(path, &table, load.first);
+            }
+            check(loaded && table.Size() == 4, string(load.second) + " loads records longer than a block", __FILE__, __LINE__);
+            check(table.findCourse("CSCI200").name == names[0] && table.findCourse("CSCI300").name == names[1],
+                string(load.second) + " keeps the long names", __FILE__, __LINE__);
+        }
+        PipelineStats stats;
+        {
+            Quiet quiet;
+            CHECK(loadCoursesPipelined(path, nullptr, &stats));
+        }
+        CHECK_EQ(stats.courses, 4u);
+        CHECK_EQ(stats.lines, 4u);
+
+        writeFile(path, "CSCI100,Intro\nCSCI101,Two\nCSCI400,\"" + string(PIPELINE_RECORD_LIMIT, 'c') + "\nCSCI500,x\n");
+        ostringstream messages;
+        streambuf* original = cout.rdbuf(messages.rdbuf());
+        bool valid = loadCoursesPipelined(path, nullptr, &stats);
+        cout.rdbuf(original);
+        CHECK(!valid);
+        CHECK(messages.str().find("Error line 3: Unterminated quoted field.") != string::npos);
+        CHECK_EQ(stats.courses, 2u);
+        remove(path.c_str());
+    }
+
+    // every stored course is found under every storage mode and hash policy, nothing else is
+    void testLookups()
+    {
+        const string path = "test_lookups.csv";
+        CatalogOptions options;
+        options.courses = 5000;
+        {
+            Quiet quiet;
+            CHECK(generateCatalog(path, options));
+        }
+        for (const auto& storage : STORAGE_MODES)
+        {
+            for (HashPolicy policy : { HashPolicy::Word, HashPolicy::Polynomial })
+            {
+                CourseHashTable table(storage.first, policy, 12345);
+                {
+                    Quiet quiet;
+                    CHECK(loadCourses(path, &table, LoadMode::Mapped));
+                }
+                vector<string> keys;
+                table.forEachCourse([&](CourseId id, const CourseId*, size_t) { keys.emplace_back(table.courseNumberOf(id)); });
+                size_t hits = 0, misses = 0;
+                for (const string& key : keys)
+                {
+                    if (table.findCourse(key) && table.searchCourse(key).courseNumber == key) hits++;
+                    if (table.findCourse(key + "#")) misses++;
+                }
+                check(hits == keys.size() && misses == 0, string(storage.second) + " finds every course", __FILE__, __LINE__);
+                CHECK_EQ(keys.size(), options.courses);
+            }
+        }
+        remove(path.c_str());
+    }
+
+    // threads inserting into a sharded table at once lose nothing
+    void testShardedInserts()
+    {
+        constexpr size_t COURSES = 20000;
+        constexpr size_t THREADS = 4;
+        ShardedCourseTable table(8);
+        Quiet quiet; // resize messages
+        vector<thread> workers;
+        for (size_t t = 0; t < THREADS; t++)
+        {
+            workers.emplace_back([&, t]()
+                {
+                    for (size_t i = t; i < COURSES; i += THREADS)
+                    {
+                        Course course;
+                        course.courseNumber = "CSCI" + to_string(i);
+                        course.name = "Course " + to_string(i);
+                        table.Insert(course);
+                    }
+                });
+        }
+        for (thread& worker : workers) worker.join();
+        CHECK_EQ(table.Size(), COURSES);
+        size_t found = 0;
+        for (size_t i = 0; i < COURSES; i++)
+        {
+            if (table.searchCourse("CSCI" + to_string(i)).name == "Course " + to_string(i)) found++;
+        }
+        CHECK_EQ(found, COURSES);
+        CHECK(table.Remove("CSCI7"));
+        CHECK(!table.Remove("CSCI7"));
+        CHECK_EQ(table.Size(), COURSES - 1);
+    }
+
+    // a snapshot maps back to the same catalog, verified or not, and damage is caught without the checksum
+    void testSnapshotRoundTrip()
+    {
+        const string csvPath = "test_snapshot.csv";
+        const string snapshotPath = "test_snapshot.snap";
+        CatalogOptions options;
+        options.courses = 5000;
+        CourseHashTable source;
+        {
+            Quiet quiet;
+            CHECK(generateCatalog(csvPath, options));
+            CHECK(loadCourses(csvPath, &source));
+            CHECK(source.saveSnapshot(snapshotPath));
+        }
+        CHECK(isSnapshotFile(snapshotPath));
+        CHECK(!isSnapshotFile(csvPath));
+        string expected = dump(source);
+        for (bool verify : { true, false })
+        {
+            CourseHashTable mapped(StorageMode::Flat);
+            {
+                Quiet quiet;
+                CHECK(mapped.loadSnapshot(snapshotPath, verify));
+            }
+            CHECK_EQ(mapped.Size(), source.Size());
+            CHECK(dump(mapped) == expected);
+            CHECK(!mapped.findCourse("NOPE999"));
+            // the first change copies the mapping into the table's own storage
+            Course course;
+            course.courseNumber = "ZZZZ999";
+            course.name = "Added";
+            course.prerequisites.push_back(string(source.courseNumberOf(0)));
+            mapped.Insert(course);
+            CHECK_EQ(mapped.Size(), source.Size() + 1);
+            CHECK(mapped.findCourse("ZZZZ999").name == "Added");
+        }
+
+        // a truncated file and a record pointing past the strings
+        string bytes;
+        {
+            ifstream file(snapshotPath, ios::binary);
+            bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        }
+        CourseHashTable damaged;
+        writeFile(snapshotPath, bytes.substr(0, bytes.size() / 2));
+        {
+            Quiet quiet;
+            CHECK(!damaged.loadSnapshot(snapshotPath, false));
+        }
+        // the header's recordsOffset follows the magic, version, byte order tag and eight other 64 bit fields
+        uint64_t recordsOffset;
+        memcpy(&recordsOffset, bytes.data() + 16 + 8 * 8, sizeof(recordsOffset));
+        uint32_t farAway = UINT32_MAX - 16;
+        memcpy(&bytes[static_cast<size_t>(recordsOffset)], &farAway, sizeof(farAway)); // the first record's nameOffset
+        writeFile(snapshotPath, bytes);
+        {
+            Quiet quiet;
+            CHECK(!damaged.loadSnapshot(snapshotPath, false));
+            CHECK(!damaged.loadSnapshot(snapshotPath, true));
+        }
+        CHECK_EQ(damaged.Size(), 0u);
+        remove(csvPath.c_str());
+        remove(snapshotPath.c_str());
+    }
+
+    // change files and full catalogs apply, and a rejected one changes nothing
+    void testCatalogChanges()
+    {
+        const string catalogPath = "test_changes_catalog.csv";
+        const string changePath = "test_changes.csv";
+        writeFile(catalogPath, "CSCI100,Intro\nCSCI200,Data,CSCI100\nCSCI300,Algorithms,CSCI200\nCSCI400,Systems,CSCI100\n");
+        auto fresh = [&](CourseHashTable& table)
+            {
+                Quiet quiet;
+                CHECK(loadCourses(catalogPath, &table));
+            };
+        auto apply = [&](CourseHashTable& table, const string& changes)
+            {
+                writeFile(changePath, changes);
+                Quiet quiet;
+                return applyCatalogChanges(changePath, &table);
+            };
+
+        CourseHashTable table;
+        fresh(table);
+        CHECK(apply(table, "+,CSCI500,Capstone,CSCI300\n+,CSCI200,\"Data, Revised\",CSCI100\n-,CSCI400\n"));
+        CHECK_EQ(dump(table), "CSCI100,Intro\nCSCI200,\"Data, Revised\",CSCI100\nCSCI300,Algorithms,CSCI200\nCSCI500,Capstone,CSCI300\n");
+        // a prerequisite added by the same change file
+        CHECK(apply(table, "+,CSCI600,Thesis,CSCI550\n+,CSCI550,Seminar\n"));
+        CHECK(table.findCourse("CSCI600").prerequisiteCount == 1);
+
+        // a full catalog applies as the differences to the loaded one
+        fresh(table);
+        CHECK(apply(table, "CSCI100,Intro\nCSCI200,Data,CSCI100\nCSCI300,\"Algorithms II\",CSCI200\nCSCI700,New,CSCI300\n"));
+        CHECK_EQ(dump(table), "CSCI100,Intro\nCSCI200,Data,CSCI100\nCSCI300,Algorithms II,CSCI200\nCSCI700,New,CSCI300\n");
+
+        const char* rejected[] = {
+            "-,CSCI999\n", // not loaded
+            "-,CSCI100\n", // still required by CSCI200 and CSCI400
+            "+,CSCI500,Capstone,CSCI999\n", // unknown prerequisite
+            "-,CSCI300\n+,CSCI500,Capstone,CSCI300\n", // prerequisite removed by the same delta
+            "+,CSCI500,One\n+,CSCI500,Two\n", // changed twice
+            "-,CSCI400\n+,CSCI400,Again\n", // changed twice
+            "*,CSCI500,Star\n+,CSCI600,Fine\n", // not a change line
+            "-,CSCI400,CSCI300\n", // a removal names one course
+            "+,CSCI500,\"open\n", // unterminated quote
+        };
+        CourseHashTable reference;
+        fresh(reference);
+        for (const char* changes : rejected)
+        {
+            fresh(table);
+            check(!apply(table, changes), string("rejects ") + changes, __FILE__, __LINE__);
+            check(dump(table) == dump(reference), string("unchanged after ") + changes, __FILE__, __LINE__);
+        }
+        remove(catalogPath.c_str());
+        remove(changePath.c_str());
+    }
+}
+
+int main()
+{
+    const pair<const char*, void (*)()> tests[] = {
+        { "csv reader", testCsvReader },
+        { "loaders agree", testLoadersAgree },
+        { "long records", testLongRecords },
+        { "lookups", testLookups },
+        { "sharded inserts", testShardedInserts },
+        { "snapshot round trip", testSnapshotRoundTrip },
+        { "catalog changes", testCatalogChanges },
+    };
+    metrics().enabled = false;
+    for (const auto& test : tests)
+    {
+        int before = failures;
+        test.second();
+        cerr << (failures == before ? "ok     " : "FAILED ") << test.first << endl;
+    }
+    cerr << (failures == 0 ? "All tests passed" : to_string(failures) + " checks failed") << endl;
+    return failures == 0 ? 0 : 1;
+}